@@ -0,0 +1,132 @@
+
+#include "Actor.h"
+#include "Scheduler.h" // For UNSCHEDULED.
+
+bool operator == ( const ThingData& r1, const ThingData& r2 )
+{ return r1.name == r2.name; }
+bool operator == ( const ThingData& r, const std::string& name )
+{ return r.name == name; }
+bool operator == ( const std::string& name, const ThingData& r )
+{ return r == name; }
+
+void Actor::set_base( const Stats& s )
+{
+    actors.info[ actors.at(id) ].base = s;
+    refresh_stats();
+}
+
+void Actor::refresh_stats() const
+{
+    unsigned int i = actors.at( id );
+    actors.stats[i] = actors.info[i].base + actors.info[i].weapon.stats;
+}
+
+void Actor::pickup( Item&& item ) const
+{
+    inventory().emplace_back( std::move(item) );
+}
+
+bool Actor::drop( II ii ) const
+{
+    if( in_inventory(ii) ) {
+        inventory().erase( std::begin(inventory()) + ii );
+        return true;
+    }
+
+    return false;
+}
+
+bool Actor::unwield() const
+{
+    bool ret;
+    if( (ret = wielding()) ) {
+        Item& weapon = actors.info[ actors.at(id) ].weapon;
+        pickup( std::move(weapon) );
+        weapon = FIST;
+        refresh_stats();
+        clamp_hp();
+    }
+    return ret;
+}
+
+bool Actor::wield( II ii ) const
+{
+    bool ret;
+    if( (ret = in_inventory(ii)) ) {
+        if( wielding() ) unwield();
+
+        auto it = std::begin(inventory()) + ii;
+        actors.info[ actors.at(id) ].weapon = std::move( *it );
+        inventory().erase( it );
+
+        refresh_stats();
+        clamp_hp();
+    }
+
+    return ret;
+}
+
+Actor ActorStore::create()
+{
+    ActorId id;
+    if( freeIds.size() ) {
+        id = freeIds.back();
+        freeIds.pop_back();
+    } else {
+        id = index.size();
+        index.push_back( 0 );
+        turnSlot.push_back( UNSCHEDULED );
+    }
+
+    index[id] = ids.size();
+    turnSlot[id] = UNSCHEDULED;
+
+    pos.push_back( Vec(0,0) );
+    nextMove.push_back( 0 );
+    hp.push_back( 0 );
+    race.push_back( 0 );
+    stats.push_back( Actor::FIST.stats );
+    ids.push_back( id );
+
+    info.push_back( ActorInfo() );
+    info.back().weapon = Actor::FIST;
+    info.back().base.fill( 0 );
+
+    return Actor( id );
+}
+
+/* Move the back of v into v[i] and shrink v. */
+template< typename T >
+static void _swap_remove( std::vector<T>& v, unsigned int i )
+{
+    if( i != v.size() - 1 )
+        v[i] = std::move( v.back() );
+    v.pop_back();
+}
+
+void ActorStore::destroy( Actor a )
+{
+    unsigned int i = at( a.id );
+
+    _swap_remove( pos, i );
+    _swap_remove( nextMove, i );
+    _swap_remove( hp, i );
+    _swap_remove( race, i );
+    _swap_remove( stats, i );
+    _swap_remove( ids, i );
+    _swap_remove( info, i );
+
+    // Whoever was at the back now lives at i.
+    if( i < ids.size() )
+        index[ ids[i] ] = i;
+
+    turnSlot[a.id] = UNSCHEDULED;
+    freeIds.push_back( a.id );
+}
+
+void ActorStore::clear()
+{
+    pos.clear(); nextMove.clear(); hp.clear(); race.clear(); stats.clear();
+    ids.clear(); info.clear();
+    index.clear(); turnSlot.clear(); freeIds.clear();
+}
@@ -0,0 +1,244 @@
+
+#pragma once
+
+#include "Vector.h"
+#include "Rogue.h" // For Vec.
+
+#include "libtcod.hpp"
+
+#include <array>
+#include <vector>
+#include <string>
+
+enum StatType {
+    HP,
+    STRENGTH,
+    AGILITY,
+    DEXTERITY,
+    ACCURACY,
+    NUTRITION,
+    N_STATS
+};
+
+/*
+ * One int per StatType, padded with zeros to a whole number of SIMD
+ * registers so that the arithmetic below is a few vector instructions,
+ * with no tail to handle. Aggregate initialization, as Stats{{ ... }},
+ * leaves the padding zero.
+ */
+struct Stats
+{
+    static const size_t LANES = 8;
+
+    alignas(16) int v[ LANES ];
+
+    int&       operator [] ( size_t i )       { return v[i]; }
+    const int& operator [] ( size_t i ) const { return v[i]; }
+
+    void fill( int x ) 
+    { 
+        for( size_t i=0; i < N_STATS; i++ ) v[i] = x; 
+        for( size_t i=N_STATS; i < LANES; i++ ) v[i] = 0; 
+    }
+};
+
+static_assert( N_STATS <= Stats::LANES, "Stats needs more lanes." );
+
+inline Stats operator+( const Stats& a, const Stats& b )
+{
+    Stats c;
+    for( size_t i=0; i < Stats::LANES; i++ ) c.v[i] = a.v[i] + b.v[i];
+    return c;
+}
+
+inline Stats operator-( const Stats& a, const Stats& b )
+{
+    Stats c;
+    for( size_t i=0; i < Stats::LANES; i++ ) c.v[i] = a.v[i] - b.v[i];
+    return c;
+}
+
+inline Stats operator*( const Stats& a, const Stats& b )
+{
+    Stats c;
+    for( size_t i=0; i < Stats::LANES; i++ ) c.v[i] = a.v[i] * b.v[i];
+    return c;
+}
+
+// Division has no vector instruction, and the padding would divide by zero.
+inline Stats operator/( const Stats& a, const Stats& b )
+{
+    Stats c;
+    for( size_t i=0; i < N_STATS; i++ ) c.v[i] = a.v[i] / b.v[i];
+    for( size_t i=N_STATS; i < Stats::LANES; i++ ) c.v[i] = 0;
+    return c;
+}
+
+struct ThingData
+{
+    const char* name;
+    char symbol; // Thing's image.
+    TCODColor color;
+    Stats stats;
+
+    // At what levels this thing will spawn (inclusive).
+    int minlvl, maxlvl; // {-1,-1} means never spawn naturally.
+};
+
+/*
+ * Assume that two different things have different names and two things with
+ * the same name have the same attributes.
+ */
+bool operator == ( const ThingData& r1, const ThingData& r2 );
+bool operator == ( const ThingData& r, const std::string& name );
+bool operator == ( const std::string& name, const ThingData& r );
+
+// things.cpp
+extern std::vector< ThingData > catalogue;
+extern std::vector< ThingData > races;
+
+/* An index into catalogue (for items) or races (for actors). */
+typedef unsigned short ThingId;
+
+// Things the code refers to directly; they must match their tables.
+const ThingId FIST_ID   = 0;
+const ThingId CORPSE_ID = 4;
+const ThingId HUMAN_ID  = 0;
+
+struct Item
+{
+    ThingId id; // What it is. The name is only for display.
+    ThingId race; // For a corpse, whose it is, as an index into races.
+    std::string name;
+    char symbol;
+    Stats stats;
+
+    Item() { }
+    Item( ThingId id )
+        : id( id ), race( 0 ), name( catalogue[id].name ), 
+          symbol( catalogue[id].symbol ), stats( catalogue[id].stats )
+    {
+    }
+};
+
+typedef unsigned int ActorId;
+const ActorId NOBODY = ActorId(-1);
+
+/*
+ * A handle to an actor in the ActorStore.
+ * Handles stay valid until the actor is destroyed, no matter how many others
+ * come and go. Data is reached through accessors returning references into
+ * the store.
+ */
+struct Actor
+{
+    static const Item FIST;
+
+    typedef std::vector<Item> Inventory;
+    typedef Inventory::size_type II; // Inventory Index.
+
+    ActorId id;
+
+    Actor( ActorId id = NOBODY ) : id( id ) {}
+
+    // Hot data.
+    Vec& pos() const;
+    int& hp() const;
+    int& nextMove() const;
+    ThingId& race() const;
+    const Stats& stats() const; // base + weapon.stats
+
+    // Cold data.
+    std::string& name() const;
+    Inventory& inventory() const;
+    const Item& weapon() const;
+    const Stats& base() const;
+
+    void set_base( const Stats& s );
+
+    bool in_inventory( II ii ) const { return ii < inventory().size(); }
+    void clamp_hp() const { if( hp() > stats()[HP] ) hp() = stats()[HP]; }
+
+    void pickup( Item&& item ) const;
+    bool drop( II ii ) const;
+
+    bool wielding() const { return weapon().id != FIST_ID; }
+    bool unwield() const;
+    bool wield( II ii ) const;
+
+  private:
+    // Recompute the cached stats() after base or weapon change.
+    void refresh_stats() const;
+};
+
+inline bool operator == ( Actor a, Actor b ) { return a.id == b.id; }
+inline bool operator != ( Actor a, Actor b ) { return a.id != b.id; }
+
+/* The parts of an actor that aren't looked at every turn. */
+struct ActorInfo
+{
+    std::string name;
+    Actor::Inventory inventory;
+    Item weapon; // Slot A
+    Stats base;
+};
+
+/*
+ * Structure-of-arrays storage for every living actor.
+ *
+ * Data is kept densely in [0, size()): scanning pos or nextMove for all
+ * actors walks contiguous memory. Destroying an actor moves the last one into
+ * its place, so dense indices change; Actor handles don't.
+ */
+struct ActorStore
+{
+    // Hot data, by dense index.
+    std::vector< Vec >     pos;
+    std::vector< int >     nextMove;
+    std::vector< int >     hp;
+    std::vector< ThingId > race;
+    std::vector< Stats >   stats;
+    std::vector< ActorId > ids; // The handle of each dense index.
+
+    // Cold data, by dense index.
+    std::vector< ActorInfo > info;
+
+    // By handle: its dense index and its slot in the turn scheduler.
+    std::vector< unsigned int > index;
+    std::vector< size_t >       turnSlot;
+
+    // Handles of destroyed actors, free for reuse.
+    std::vector< ActorId > freeIds;
+
+    size_t size() const { return ids.size(); }
+
+    unsigned int at( ActorId id ) const { return index[id]; }
+
+    Actor operator [] ( size_t i ) const { return Actor( ids[i] ); }
+
+    /* Add a new actor wielding nothing and return its handle. */
+    Actor create();
+    void destroy( Actor a );
+    void clear();
+};
+
+// main.cpp
+extern ActorStore actors;
+
+inline Vec& Actor::pos() const { return actors.pos[ actors.at(id) ]; }
+inline int& Actor::hp()  const { return actors.hp[ actors.at(id) ];  }
+inline int& Actor::nextMove() const
+{ return actors.nextMove[ actors.at(id) ]; }
+inline ThingId& Actor::race() const
+{ return actors.race[ actors.at(id) ]; }
+inline const Stats& Actor::stats() const
+{ return actors.stats[ actors.at(id) ]; }
+
+inline std::string& Actor::name() const
+{ return actors.info[ actors.at(id) ].name; }
+inline Actor::Inventory& Actor::inventory() const
+{ return actors.info[ actors.at(id) ].inventory; }
+inline const Item& Actor::weapon() const
+{ return actors.info[ actors.at(id) ].weapon; }
+inline const Stats& Actor::base() const
+{ return actors.info[ actors.at(id) ].base; }
@@ -0,0 +1,118 @@
+
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <cstddef>
+
+/*
+ * One bit per cell of a width by height grid, packed 64 to a word in
+ * row-major order, so that operations over a whole plane go a word at a time.
+ * Bits past the last cell are always zero.
+ */
+struct BitPlane
+{
+    typedef uint64_t Word;
+    static const size_t WORD_BITS = 64;
+
+    std::vector< Word > words;
+    size_t width, height;
+
+    BitPlane() : width(0), height(0) {}
+    BitPlane( size_t w, size_t h ) { reset( w, h ); }
+
+    void reset( size_t w, size_t h )
+    {
+        width = w;
+        height = h;
+        words.assign( (w*h + WORD_BITS-1) / WORD_BITS, 0 );
+    }
+
+    size_t area() const { return width * height; }
+
+    bool get( size_t x, size_t y ) const
+    {
+        size_t i = y*width + x;
+        return (words[i / WORD_BITS] >> (i % WORD_BITS)) & 1;
+    }
+
+    void set( size_t x, size_t y )
+    {
+        size_t i = y*width + x;
+        words[i / WORD_BITS] |= Word(1) << (i % WORD_BITS);
+    }
+
+    void unset( size_t x, size_t y )
+    {
+        size_t i = y*width + x;
+        words[i / WORD_BITS] &= ~(Word(1) << (i % WORD_BITS));
+    }
+
+    void set( size_t x, size_t y, bool b )
+    {
+        if( b ) set( x, y );
+        else    unset( x, y );
+    }
+
+    void clear() { std::fill( words.begin(), words.end(), 0 ); }
+
+    // Whole-plane operations, a word at a time. Both planes must be the same
+    // size.
+    BitPlane& operator |= ( const BitPlane& b )
+    {
+        for( size_t i=0; i < words.size(); i++ ) words[i] |= b.words[i];
+        return *this;
+    }
+
+    BitPlane& operator &= ( const BitPlane& b )
+    {
+        for( size_t i=0; i < words.size(); i++ ) words[i] &= b.words[i];
+        return *this;
+    }
+
+    BitPlane& operator ^= ( const BitPlane& b )
+    {
+        for( size_t i=0; i < words.size(); i++ ) words[i] ^= b.words[i];
+        return *this;
+    }
+
+    /* Unset every bit set in b: this AND NOT b. */
+    BitPlane& unset( const BitPlane& b )
+    {
+        for( size_t i=0; i < words.size(); i++ ) words[i] &= ~b.words[i];
+        return *this;
+    }
+
+    /* Copy b's bits; unlike assignment, never reallocates. */
+    void assign( const BitPlane& b )
+    {
+        std::copy( b.words.begin(), b.words.end(), words.begin() );
+    }
+
+    bool any() const
+    {
+        for( Word w : words )
+            if( w ) return true;
+        return false;
+    }
+
+    size_t count() const
+    {
+        size_t n = 0;
+        for( Word w : words )
+            n += __builtin_popcountll( w );
+        return n;
+    }
+
+    /* Call f(x,y) for every set bit, in row-major order. */
+    template< typename F >
+    void for_each_set( F f ) const
+    {
+        for( size_t i=0; i < words.size(); i++ )
+            for( Word w = words[i]; w; w &= w - 1 ) {
+                size_t bit = i*WORD_BITS + __builtin_ctzll( w );
+                f( bit % width, bit / width );
+            }
+    }
+};
@@ -0,0 +1,148 @@
+
+#include "DistanceMap.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+namespace
+{
+
+struct Step
+{
+    int dx, dy, cost;
+};
+
+const Step STEPS[] = {
+    {  0, -1, DistanceMap::ORTHOGONAL }, { +1,  0, DistanceMap::ORTHOGONAL },
+    {  0, +1, DistanceMap::ORTHOGONAL }, { -1,  0, DistanceMap::ORTHOGONAL },
+    { -1, -1, DistanceMap::DIAGONAL   }, { +1, -1, DistanceMap::DIAGONAL   },
+    { +1, +1, DistanceMap::DIAGONAL   }, { -1, +1, DistanceMap::DIAGONAL   }
+};
+
+} // namespace
+
+const int DistanceMap::ORTHOGONAL;
+const int DistanceMap::DIAGONAL;
+const int DistanceMap::UNREACHED;
+const int DistanceMap::N_BUCKETS;
+
+DistanceMap::DistanceMap( size_t w, size_t h, int radius )
+    : root( -1, -1 ), dist( w, h, UNREACHED ), bias( 0 )
+{
+    set_radius( radius );
+}
+
+void DistanceMap::reset( size_t w, size_t h )
+{
+    dist.reset( w, h, UNREACHED );
+    bias = 0;
+    root = Vec( -1, -1 );
+}
+
+void DistanceMap::set_radius( int radius )
+{
+    maxDist = radius * ORTHOGONAL;
+}
+
+void DistanceMap::compute( const Grid<Tile>& g, const Vec& r )
+{
+    std::fill_n( dist.tiles, dist.area(), UNREACHED );
+    bias = 0;
+    root = r;
+
+    propagate( g, root.y()*dist.width + root.x(), 0 );
+}
+
+void DistanceMap::move_root( const Grid<Tile>& g, const Vec& r )
+{
+    int dx = std::abs( r.x() - root.x() ), dy = std::abs( r.y() - root.y() );
+    if( root.x() < 0 or dx > 1 or dy > 1 ) {
+        compute( g, r );
+        return;
+    }
+
+    if( not dx and not dy )
+        return;
+
+    // Going anywhere by way of the old root is now one step longer.
+    bias += dx and dy ? DIAGONAL : ORTHOGONAL;
+    root = r;
+
+    propagate( g, root.y()*dist.width + root.x(), 0 );
+}
+
+int DistanceMap::get( int x, int y ) const
+{
+    if( x < 0 or y < 0 or x >= int(dist.width) or y >= int(dist.height) )
+        return -1;
+
+    int d = dist.get( x, y );
+    if( d == UNREACHED or d + bias > maxDist )
+        return -1;
+    return d + bias;
+}
+
+bool DistanceMap::descend( Vec& pos ) const
+{
+    int best = get( pos );
+    if( best <= 0 )
+        return false;
+
+    Vec next = pos;
+    for( const Step& s : STEPS ) {
+        int d = get( pos.x() + s.dx, pos.y() + s.dy );
+        if( d >= 0 and d < best ) {
+            best = d;
+            next = Vec( pos.x() + s.dx, pos.y() + s.dy );
+        }
+    }
+
+    if( next == pos )
+        return false;
+    pos = next;
+    return true;
+}
+
+void DistanceMap::propagate( const Grid<Tile>& g, unsigned int index, int d )
+{
+    const int w = dist.width, h = dist.height;
+
+    dist.tiles[index] = d - bias;
+    buckets[ d % N_BUCKETS ].push_back( index );
+    size_t queued = 1;
+
+    for( ; queued; d++ ) {
+        std::vector< unsigned int >& bucket = buckets[ d % N_BUCKETS ];
+
+        // Steps cost more than nothing, so nothing joins this bucket now.
+        for( size_t b=0; b < bucket.size(); b++ ) {
+            unsigned int i = bucket[b];
+
+            // Already found a shorter way here.
+            if( dist.tiles[i] + bias < d )
+                continue;
+
+            int x = i % w, y = i / w;
+            for( const Step& s : STEPS ) {
+                int nx = x + s.dx, ny = y + s.dy;
+                if( nx < 0 or ny < 0 or nx >= w or ny >= h )
+                    continue;
+
+                int nd = d + s.cost;
+                if( nd > maxDist or not g.get(nx, ny).walkable() )
+                    continue;
+
+                unsigned int n = ny*w + nx;
+                int old = dist.tiles[n];
+                if( old == UNREACHED or old + bias > nd ) {
+                    dist.tiles[n] = nd - bias;
+                    buckets[ nd % N_BUCKETS ].push_back( n );
+                    queued++;
+                }
+            }
+        }
+
+        queued -= bucket.size();
+        bucket.clear();
+    }
+}
@@ -0,0 +1,65 @@
+
+#pragma once
+
+#include "Rogue.h"
+
+#include <vector>
+#include <climits>
+
+/*
+ * Walking distance from a root tile to every walkable tile within a radius,
+ * by Dijkstra's algorithm. Orthogonal steps cost ORTHOGONAL, diagonal ones
+ * DIAGONAL. Since those are small integers, the priority queue is a ring of
+ * buckets, one per distance, rather than a heap.
+ *
+ * When the root takes a single step, move_root() repairs the map instead of
+ * recomputing it. Every old distance, plus the cost of the step, is still
+ * the length of a real path (through the old root), so all distances are
+ * shifted at once by a bias and only the tiles that got closer are touched.
+ */
+struct DistanceMap
+{
+    static const int ORTHOGONAL = 10;
+    static const int DIAGONAL   = 14;
+
+    Vec root;
+
+    DistanceMap( size_t w, size_t h, int radius );
+
+    /* Change the size and forget everything. */
+    void reset( size_t w, size_t h );
+
+    /* Stop expanding past radius tiles' worth of orthogonal steps. */
+    void set_radius( int radius );
+    int radius() const { return maxDist / ORTHOGONAL; }
+
+    /* Compute from scratch. */
+    void compute( const Grid<Tile>& g, const Vec& root );
+
+    /* Move the root; repair the map if it only took a step. */
+    void move_root( const Grid<Tile>& g, const Vec& root );
+
+    /* Distance to root, or -1 if unreachable or beyond the radius. */
+    int get( int x, int y ) const;
+    int get( const Vec& pos ) const { return get( pos.x(), pos.y() ); }
+
+    /* Step pos to its neighbour nearest root. False at root or if stuck. */
+    bool descend( Vec& pos ) const;
+
+  private:
+    static const int UNREACHED = INT_MAX;
+
+    // Everything queued is within DIAGONAL of the nearest, so this many
+    // buckets, indexed by distance modulo N_BUCKETS, never overlap.
+    static const int N_BUCKETS = DIAGONAL + 1;
+
+    // Real distance = dist + bias, unless UNREACHED.
+    Grid< int > dist;
+    int bias;
+    int maxDist;
+
+    std::vector< unsigned int > buckets[ N_BUCKETS ];
+
+    // Relax outward from index at real distance d, lowering distances only.
+    void propagate( const Grid<Tile>& g, unsigned int index, int d );
+};
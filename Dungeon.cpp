@@ -0,0 +1,130 @@
+
+#include "Dungeon.h"
+#include "random.h"
+#include "trace.h"
+
+#include <chrono>
+
+namespace
+{
+
+// Sets level seeds apart from the game's own streams, which are seeded with
+// the dungeon's seed as it is.
+const uint64_t MAPGEN_SALT = 0x6c6576656c73ULL; // "levels"
+
+bool spawns_at( const ThingData& t, unsigned int depth )
+{
+    return t.minlvl >= 0 and unsigned(t.minlvl) <= depth 
+       and depth <= unsigned(t.maxlvl);
+}
+
+// What from table can spawn at depth, or anything that ever spawns if
+// nothing's meant to be this deep.
+std::vector< ThingId > available( const std::vector<ThingData>& table, 
+                                  unsigned int depth )
+{
+    std::vector< ThingId > ids;
+    for( ThingId id=0; id < table.size(); id++ )
+        if( spawns_at(table[id], depth) )
+            ids.push_back( id );
+
+    if( ids.empty() )
+        for( ThingId id=0; id < table.size(); id++ )
+            if( table[id].minlvl >= 0 )
+                ids.push_back( id );
+
+    return ids;
+}
+
+ThingId pick( const std::vector<ThingId>& ids )
+{
+    return ids[ rng(MAPGEN).below(ids.size()) ];
+}
+
+} // namespace
+
+void Dungeon::start( unsigned long s, size_t w, size_t h, const MapFn& f )
+{
+    stop();
+
+    seed = s;
+    width = w;
+    height = h;
+    make_map = f;
+
+    quit = false;
+    worker = std::thread( &Dungeon::work, this );
+}
+
+void Dungeon::stop()
+{
+    quit = true;
+    if( worker.joinable() )
+        worker.join();
+
+    // Throw away levels nobody went down to.
+    Level l;
+    while( ready.pop(l) )
+        ;
+}
+
+Level Dungeon::next()
+{
+    Level l;
+    while( not ready.pop(l) )
+        std::this_thread::yield();
+    return l;
+}
+
+Level Dungeon::generate( unsigned int depth ) const
+{
+    TRACE_SCOPE( "Dungeon::generate" );
+
+    // Mixed, so that neighbouring depths, and neighbouring seeds, get
+    // unrelated levels: seed S at depth d+1 isn't seed S+1 at depth d.
+    rng( MAPGEN ).seed( rng_detail::splitmix(seed ^ MAPGEN_SALT, depth) );
+
+    Level l;
+    l.depth = depth;
+    l.grid.reset( width, height, '#' );
+
+    std::vector< Vec > spawns = make_map( l.grid );
+    if( spawns.empty() ) {
+        l.entrance = Vec( -1, -1 );
+        return l;
+    }
+
+    l.entrance = spawns.front();
+    if( spawns.size() > 1 ) {
+        l.grid.get( spawns.back() ).c = '>';
+        spawns.pop_back();
+    }
+
+    // Up to nine monsters join the player; items take the rest.
+    const unsigned int N_MONSTERS = 9;
+    std::vector< ThingId > races = available( ::races, depth );
+    std::vector< ThingId > items = available( catalogue, depth );
+
+    for( unsigned int i=1; i < spawns.size(); i++ ) {
+        if( i <= N_MONSTERS )
+            l.monsters.push_back( Spawn{ spawns[i], pick(races), pick(items) } );
+        else
+            l.items.push_back( Spawn{ spawns[i], pick(items), FIST_ID } );
+    }
+
+    return l;
+}
+
+void Dungeon::work()
+{
+    TRACE_THREAD( "dungeon" );
+
+    for( unsigned int depth=0; not quit; depth++ ) {
+        Level l = generate( depth );
+        while( not ready.push(std::move(l)) ) {
+            if( quit )
+                return;
+            std::this_thread::sleep_for( std::chrono::milliseconds(1) );
+        }
+    }
+}
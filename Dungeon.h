@@ -0,0 +1,77 @@
+
+#pragma once
+
+#include "Rogue.h"
+#include "Actor.h" // For ThingId.
+#include "SpscQueue.h"
+
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <functional>
+
+/* Something to put on a level: a race for actors, an item otherwise. */
+struct Spawn
+{
+    Vec pos;
+    ThingId id;
+    ThingId weapon; // What a monster wields.
+};
+
+/* A generated level, before anyone's on it. */
+struct Level
+{
+    unsigned int depth;
+    Grid< Tile > grid;
+
+    Vec entrance; // Where the player arrives.
+    std::vector< Spawn > monsters, items;
+
+    Level() : depth( 0 ) {}
+};
+
+/*
+ * The levels below the current one.
+ *
+ * A worker thread generates the next LOOKAHEAD levels ahead of time and hands
+ * them over through a lock-free queue, so going down is a move, not a wait.
+ * Each level is generated from its own seed, derived from the dungeon's seed
+ * and its depth, so it comes out the same whichever thread made it.
+ */
+struct Dungeon
+{
+    static const size_t LOOKAHEAD = 2;
+
+    /* 
+     * Fill a wall-filled grid with a map; return its spawn points. The last
+     * becomes the stairs down, the first the entrance.
+     */
+    typedef std::function< std::vector<Vec>( Grid<Tile>& ) > MapFn;
+
+    Dungeon() : quit( false ) {}
+    ~Dungeon() { stop(); }
+
+    /* Start generating levels of w by h tiles, from depth 0. */
+    void start( unsigned long seed, size_t w, size_t h, const MapFn& f );
+    void stop();
+
+    /* The next level down. Waits only if the worker has fallen behind. */
+    Level next();
+
+    /* Generate the level at depth; what the worker runs. */
+    Level generate( unsigned int depth ) const;
+
+  private:
+    unsigned long seed;
+    size_t width, height;
+    MapFn make_map;
+
+    std::thread worker;
+    std::atomic< bool > quit;
+    SpscQueue< Level, LOOKAHEAD > ready;
+
+    void work();
+};
+
+// main.cpp
+extern Dungeon dungeon;
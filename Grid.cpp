@@ -29,7 +29,7 @@ int _split_pos( int min, int max, int len )
         max -= range / 4;
     }
 
-    return random( min, max );
+    return rng( MAPGEN ).range( min, max );
 }
 
 std::pair<Room,Room> hsplit( const Room& r, int len )
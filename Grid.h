@@ -1,7 +1,9 @@
 
 #include "Vector.h"
+#include "BitPlane.h"
 
 #include <iterator>
+#include <vector>
 #include <algorithm>
 
 #pragma once
@@ -120,6 +122,9 @@ struct Grid
     Tile* tiles;
     size_t width, height;
 
+    // Optional one-bit flags per tile, each in its own plane. See reset_flags().
+    std::vector< BitPlane > flagPlanes;
+
     Grid() : tiles(0), width(0), height(0) {}
     Grid( size_t w, size_t h, const Tile& t )
         : tiles(new Tile[ w * h ]), width(w), height(h)
@@ -127,6 +132,21 @@ struct Grid
 
     ~Grid() { if(tiles) delete [] tiles; }
 
+    // Grids own their tiles: they move, in O(1), but don't copy.
+    Grid( const Grid& ) = delete;
+    Grid& operator = ( const Grid& ) = delete;
+
+    Grid( Grid&& other ) : tiles(0), width(0), height(0) { swap( other ); }
+    Grid& operator = ( Grid&& other ) { swap( other ); return *this; }
+
+    void swap( Grid& other )
+    {
+        std::swap( tiles,  other.tiles );
+        std::swap( width,  other.width );
+        std::swap( height, other.height );
+        flagPlanes.swap( other.flagPlanes );
+    }
+
     void reset( size_t w, size_t h, const Tile& t )
     {
         width = w;
@@ -135,8 +155,30 @@ struct Grid
             delete [] tiles;
         tiles = new Tile[ area() ];
         std::fill_n( tiles, area(), t );
+        reset_flags( flagPlanes.size() );
     }
 
+    /* Keep n flags per tile, numbered from 0, all unset. */
+    void reset_flags( size_t n )
+    {
+        flagPlanes.assign( n, BitPlane(width, height) );
+    }
+
+    /* All of one flag, for operating on the whole grid at once. */
+    BitPlane& flags( size_t f ) { return flagPlanes[f]; }
+    const BitPlane& flags( size_t f ) const { return flagPlanes[f]; }
+
+    bool flag( size_t f, size_t x, size_t y ) const 
+    { return flagPlanes[f].get( x, y ); }
+    void set_flag( size_t f, size_t x, size_t y, bool b=true )
+    { flagPlanes[f].set( x, y, b ); }
+
+    template< typename U > bool flag( size_t f, const Vector<U,2>& pos ) const
+    { return flag( f, pos.x(), pos.y() ); }
+    template< typename U > 
+    void set_flag( size_t f, const Vector<U,2>& pos, bool b=true )
+    { set_flag( f, pos.x(), pos.y(), b ); }
+
     size_t area() const { return width * height; }
 
     reference get( size_t x, size_t y ) 
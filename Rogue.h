@@ -4,22 +4,61 @@
 #include "Vector.h"
 #include "Grid.h"
 
+#include <array>
+
 typedef Vector<int,2> Vec;
 
+/* The kinds of tile there are; indices into tileTypes. */
+enum TileKind
+{
+    TILE_NONE, // Any glyph that isn't a tile.
+    TILE_FLOOR,
+    TILE_WALL,
+    TILE_STAIRS_DOWN,
+    N_TILE_KINDS
+};
+
+/* Everything about a kind of tile that doesn't change. */
+struct TileType
+{
+    char glyph;
+    bool walkable;    // Can be walked on.
+    bool transparent; // Light, and sight, can pass through.
+    const char* description;
+};
+
+// Tile.cpp
+extern const TileType tileTypes[ N_TILE_KINDS ];
+extern const std::array< unsigned char, 256 > tileKinds; // By glyph.
+
+inline TileKind kind_of( char glyph ) 
+{ 
+    return TileKind( tileKinds[(unsigned char)glyph] ); 
+}
+
 struct Tile
 {
-    bool seen      : 1;
-    bool visible   : 1;
-    bool highlight : 1; 
     char c;
 
-    Tile() : c(' ') { init(); }
+    Tile() : c(' ') {}
 
     // Allow implicit construction.
-    Tile( char c ) : c(c) { init(); }
+    Tile( char c ) : c(c) {}
+
+    TileKind kind() const { return kind_of( c ); }
+    const TileType& type() const { return tileTypes[ kind() ]; }
 
-  private:
-    void init() { seen = visible = highlight = false; }
+    bool transparent() const { return type().transparent; }
+    bool walkable() const { return type().walkable; }
+};
+
+/* What grid keeps, per tile, in its flag planes. */
+enum TileFlag
+{
+    SEEN,      // Discovered by the player.
+    VISIBLE,   // In the player's view now.
+    HIGHLIGHT, // Lit up for the next render(), like the look path.
+    N_TILE_FLAGS
 };
 
 // main.cpp
@@ -0,0 +1,136 @@
+
+#pragma once
+
+#include <vector>
+#include <cstddef>
+
+// The slot of a handle that isn't scheduled.
+const size_t UNSCHEDULED = size_t(-1);
+
+/*
+ * A turn scheduler: an indexed binary min-heap of handles keyed on the time
+ * of their next move.
+ *
+ * Handles that share a time come out in the order they were (re)scheduled,
+ * so nobody gets to cut in line. Each handle's position in the heap is kept
+ * intrusively through Slot, a functor returning a size_t& for a handle, which
+ * is what makes reschedule() and remove() O(log n) without a search.
+ */
+template< typename Handle, typename Slot >
+struct Scheduler
+{
+    struct Entry
+    {
+        int time;
+        unsigned long seq; // Tie breaker: first come, first served.
+        Handle handle;
+    };
+
+    std::vector< Entry > heap;
+    unsigned long nextSeq;
+    Slot slot;
+
+    Scheduler( const Slot& slot = Slot() ) : nextSeq(0), slot(slot) {}
+
+    bool   empty() const { return heap.empty(); }
+    size_t size()  const { return heap.size();  }
+
+    // The handle to move next. Undefined if empty.
+    Handle top() const { return heap.front().handle; }
+    int top_time() const { return heap.front().time; }
+
+    bool scheduled( Handle h ) { return slot(h) != UNSCHEDULED; }
+
+    void insert( Handle h, int time )
+    {
+        heap.push_back( Entry{ time, nextSeq++, h } );
+        slot(h) = heap.size() - 1;
+        sift_up( heap.size() - 1 );
+    }
+
+    // Move h to a new time; it goes behind anyone already waiting on it.
+    void reschedule( Handle h, int time )
+    {
+        size_t i = slot( h );
+        if( i == UNSCHEDULED ) {
+            insert( h, time );
+            return;
+        }
+
+        Entry& e = heap[i];
+        bool later = time >= e.time;
+        e.time = time;
+        e.seq  = nextSeq++;
+
+        if( later ) sift_down( i );
+        else        sift_up( i );
+    }
+
+    void remove( Handle h )
+    {
+        size_t i = slot( h );
+        if( i == UNSCHEDULED )
+            return;
+        slot(h) = UNSCHEDULED;
+
+        size_t last = heap.size() - 1;
+        if( i != last ) {
+            place( i, heap[last] );
+            heap.pop_back();
+            sift_down( i );
+            sift_up( i );
+        } else {
+            heap.pop_back();
+        }
+    }
+
+    void clear()
+    {
+        for( Entry& e : heap )
+            slot(e.handle) = UNSCHEDULED;
+        heap.clear();
+    }
+
+  private:
+    static bool before( const Entry& a, const Entry& b )
+    {
+        return a.time < b.time or (a.time == b.time and a.seq < b.seq);
+    }
+
+    void place( size_t i, const Entry& e )
+    {
+        heap[i] = e;
+        slot(heap[i].handle) = i;
+    }
+
+    void sift_up( size_t i )
+    {
+        Entry e = heap[i];
+        while( i > 0 ) {
+            size_t parent = (i - 1) / 2;
+            if( not before(e, heap[parent]) )
+                break;
+            place( i, heap[parent] );
+            i = parent;
+        }
+        place( i, e );
+    }
+
+    void sift_down( size_t i )
+    {
+        Entry e = heap[i];
+        size_t n = heap.size();
+        while( true ) {
+            size_t child = 2*i + 1;
+            if( child >= n )
+                break;
+            if( child+1 < n and before(heap[child+1], heap[child]) )
+                child++;
+            if( not before(heap[child], e) )
+                break;
+            place( i, heap[child] );
+            i = child;
+        }
+        place( i, e );
+    }
+};
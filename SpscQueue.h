@@ -0,0 +1,63 @@
+
+#pragma once
+
+#include <atomic>
+#include <utility>
+#include <cstddef>
+
+/*
+ * A fixed-size, lock-free queue for exactly one producer thread and one
+ * consumer thread. Neither side ever waits on the other; push() fails when
+ * full and pop() when empty.
+ *
+ * head and tail only ever grow; their difference is the number of elements
+ * queued. Each is written by one side only, and kept on its own cache line so
+ * the two sides don't fight over it.
+ */
+template< typename T, size_t N >
+struct SpscQueue
+{
+    SpscQueue() : head( 0 ), tail( 0 ) {}
+
+    /* Producer: move x in. False if full. */
+    bool push( T&& x )
+    {
+        size_t t = tail.load( std::memory_order_relaxed );
+        if( t - head.load(std::memory_order_acquire) == N )
+            return false;
+
+        slots[ t % N ] = std::move( x );
+        tail.store( t + 1, std::memory_order_release );
+        return true;
+    }
+
+    /* Consumer: move the oldest element into x. False if empty. */
+    bool pop( T& x )
+    {
+        size_t h = head.load( std::memory_order_relaxed );
+        if( h == tail.load(std::memory_order_acquire) )
+            return false;
+
+        x = std::move( slots[ h % N ] );
+        head.store( h + 1, std::memory_order_release );
+        return true;
+    }
+
+    /* 
+     * How many are queued. Exact from either side as to its own end, so the
+     * producer can rely on size() < N and the consumer on size() > 0.
+     */
+    size_t size() const
+    {
+        return tail.load( std::memory_order_acquire ) 
+             - head.load( std::memory_order_acquire );
+    }
+
+    size_t capacity() const { return N; }
+
+  private:
+    T slots[ N ];
+
+    alignas(64) std::atomic< size_t > head; // Next to pop.
+    alignas(64) std::atomic< size_t > tail; // Next to push.
+};
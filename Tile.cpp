@@ -0,0 +1,20 @@
+
+#include "Rogue.h"
+
+const TileType tileTypes[ N_TILE_KINDS ] = {
+    { ' ', false, false, "" },
+    { '.', true,  true,  "A stone floor." },
+    { '#', false, false, "A stone wall." },
+    { '>', true,  true,  "Stairs down." }
+};
+
+static std::array< unsigned char, 256 > _kinds_by_glyph()
+{
+    std::array< unsigned char, 256 > kinds;
+    kinds.fill( TILE_NONE );
+    for( int k=0; k < N_TILE_KINDS; k++ )
+        kinds[ (unsigned char)tileTypes[k].glyph ] = k;
+    return kinds;
+}
+
+const std::array< unsigned char, 256 > tileKinds = _kinds_by_glyph();
@@ -0,0 +1,188 @@
+#include "alloc.h"
+
+#include <cerrno>
+#include <cstdlib>
+#include <new>
+
+namespace alloc
+{
+
+const char* const TAG_NAMES[ N_TAGS ] = {
+    "other", "level", "map", "ai", "combat", "msg", "render", "ui"
+};
+
+namespace
+{
+
+// Plain zeros: ready before any constructor runs, as malloc may be called
+// before then and from threads that run none of ours.
+thread_local Count counts[ N_TAGS ];
+thread_local Tag current = OTHER;
+
+} // namespace
+
+/* Count an allocation of n bytes. Not in the header: only the hooks call it. */
+void note( size_t n )
+{
+    Count& c = counts[ current ];
+    c.allocs++;
+    c.bytes += n;
+}
+
+Count count( Tag tag )
+{
+    return counts[ tag ];
+}
+
+Count total()
+{
+    Count sum = { 0, 0 };
+    for( const Count& c : counts ) {
+        sum.allocs += c.allocs;
+        sum.bytes  += c.bytes;
+    }
+    return sum;
+}
+
+Scope::Scope( Tag tag ) : prev( current )
+{
+    current = tag;
+}
+
+Scope::~Scope()
+{
+    current = prev;
+}
+
+} // namespace alloc
+
+/*
+ * With glibc, malloc can be replaced by defining it; glibc's own functions
+ * call ours. The real one is still there, as __libc_malloc.
+ */
+#ifdef __GLIBC__
+
+extern "C" {
+
+void* __libc_malloc( size_t );
+void* __libc_calloc( size_t, size_t );
+void* __libc_realloc( void*, size_t );
+void* __libc_memalign( size_t, size_t );
+void  __libc_free( void* );
+
+void* malloc( size_t n ) __THROW
+{
+    void* p = __libc_malloc( n );
+    if( p )
+        alloc::note( n );
+    return p;
+}
+
+void* calloc( size_t n, size_t size ) __THROW
+{
+    void* p = __libc_calloc( n, size );
+    if( p )
+        alloc::note( n * size );
+    return p;
+}
+
+// realloc( p, 0 ) frees p; anything else is counted as a new allocation.
+void* realloc( void* p, size_t n ) __THROW
+{
+    void* q = __libc_realloc( p, n );
+    if( q )
+        alloc::note( n );
+    return q;
+}
+
+void* memalign( size_t align, size_t n ) __THROW
+{
+    void* p = __libc_memalign( align, n );
+    if( p )
+        alloc::note( n );
+    return p;
+}
+
+void* aligned_alloc( size_t align, size_t n ) __THROW
+{
+    return memalign( align, n );
+}
+
+int posix_memalign( void** out, size_t align, size_t n ) __THROW
+{
+    if( align % sizeof(void*) or align & (align - 1) )
+        return EINVAL;
+    void* p = memalign( align, n );
+    if( not p )
+        return ENOMEM;
+    *out = p;
+    return 0;
+}
+
+void free( void* p ) __THROW
+{
+    __libc_free( p );
+}
+
+} // extern "C"
+
+static void* raw_alloc( size_t n ) { return __libc_malloc( n ); }
+static void  raw_free( void* p )   { __libc_free( p ); }
+
+#else
+
+static void* raw_alloc( size_t n ) { return std::malloc( n ); }
+static void  raw_free( void* p )   { std::free( p ); }
+
+#endif
+
+/*
+ * operator new counts for itself, so that it's counted without glibc, and
+ * allocates around malloc so that it's not counted twice with it.
+ */
+static void* counted_new( size_t n )
+{
+    if( not n )
+        n = 1; // Every new returns a distinct pointer.
+
+    void* p;
+    while( not (p = raw_alloc(n)) ) {
+        std::new_handler handler = std::get_new_handler();
+        if( not handler )
+            return 0;
+        handler();
+    }
+
+    alloc::note( n );
+    return p;
+}
+
+void* operator new( size_t n )
+{
+    if( void* p = counted_new(n) )
+        return p;
+    throw std::bad_alloc();
+}
+
+void* operator new[]( size_t n )
+{
+    return operator new( n );
+}
+
+void* operator new( size_t n, const std::nothrow_t& ) noexcept
+{
+    try { return counted_new( n ); }
+    catch( ... ) { return 0; }
+}
+
+void* operator new[]( size_t n, const std::nothrow_t& ) noexcept
+{
+    return operator new( n, std::nothrow );
+}
+
+void operator delete( void* p ) noexcept { raw_free( p ); }
+void operator delete[]( void* p ) noexcept { raw_free( p ); }
+void operator delete( void* p, const std::nothrow_t& ) noexcept
+{ raw_free( p ); }
+void operator delete[]( void* p, const std::nothrow_t& ) noexcept
+{ raw_free( p ); }
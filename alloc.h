@@ -0,0 +1,59 @@
+
+#pragma once
+
+#include <cstddef>
+
+/*
+ * Counts every heap allocation, by thread and by what the thread was doing.
+ *
+ * Global operator new and delete are replaced, and so, with glibc, are malloc
+ * and friends, so that vasprintf and the like are counted too. Each thread
+ * counts into its own counters, under the tag of the innermost ALLOC_SCOPE
+ * it's in, so the game thread's numbers leave out the level generator's and
+ * the message sink's.
+ */
+
+/* Count allocations from here to the end of the enclosing scope as tag. */
+#define ALLOC_CAT2( a, b ) a##b
+#define ALLOC_CAT( a, b ) ALLOC_CAT2( a, b )
+#define ALLOC_SCOPE( tag ) \
+    alloc::Scope ALLOC_CAT( _allocScope, __LINE__ )( alloc::tag )
+
+namespace alloc
+{
+
+enum Tag {
+    OTHER,  // Outside any scope: the rest of the turn.
+    LEVEL,  // enter_level().
+    MAP,    // update_map(): FOV and the distance map.
+    AI,     // move_monst().
+    COMBAT, // attack().
+    MSG,    // Queueing messages.
+    RENDER,
+    UI,     // The inventory and look mode.
+    N_TAGS
+};
+
+extern const char* const TAG_NAMES[ N_TAGS ];
+
+struct Count
+{
+    unsigned long allocs, bytes;
+};
+
+inline Count operator - ( Count a, Count b )
+{ return Count{ a.allocs - b.allocs, a.bytes - b.bytes }; }
+
+/* What the calling thread has allocated under tag, or at all. */
+Count count( Tag tag );
+Count total();
+
+struct Scope
+{
+    Tag prev;
+
+    Scope( Tag tag );
+    ~Scope();
+};
+
+} // namespace alloc
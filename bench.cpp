@@ -0,0 +1,459 @@
+
+#include "Rogue.h"
+#include "BitPlane.h"
+#include "fov.h"
+#include "DistanceMap.h"
+#include "bsp.h"
+#include "random.h"
+#include "combat.h"
+#include "msg.h"
+#include "game.h"
+#include "perf.h"
+#include "alloc.h"
+
+#include "libtcod.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <chrono>
+
+/*
+ * Benchmarks for the game's hot paths.
+ * Prints one CSV line per case: its name, the map size and the mean time
+ * taken by one run. The names stay put from build to build, so two runs can
+ * be joined on them to spot regressions.
+ */
+
+/* Run f n times; return the mean time of a run in nanoseconds. */
+template< typename F >
+double time_ns( unsigned int n, F f )
+{
+    auto start = std::chrono::steady_clock::now();
+    for( unsigned int i=0; i < n; i++ )
+        f( i );
+    std::chrono::duration<double, std::nano> elapsed =
+        std::chrono::steady_clock::now() - start;
+    return elapsed.count() / n;
+}
+
+template< typename T >
+void report( const char* name, const Grid<T>& g, double ns )
+{
+    printf( "%s,%zu,%zu,%.1f\n", name, g.width, g.height, ns );
+}
+
+/* For cases that don't run on a map. */
+void report( const char* name, double ns )
+{
+    printf( "%s,,,%.1f\n", name, ns );
+}
+
+/* A cave-like map: walled border, about one wall in four inside. */
+void random_map( Grid<Tile>& g, size_t w, size_t h )
+{
+    g.reset( w, h, '.' );
+    for( size_t y=0; y < h; y++ )
+        for( size_t x=0; x < w; x++ )
+            if( x == 0 or y == 0 or x == w-1 or y == h-1 or random(3) == 0 )
+                g.get(x,y).c = '#';
+}
+
+/* Floor tiles to look from, spread over the map. */
+std::vector< Vec > sample_floors( const Grid<Tile>& g, size_t n )
+{
+    std::vector< Vec > v;
+    while( v.size() < n ) {
+        Vec p( random(1, g.width-2), random(1, g.height-2) );
+        if( g.get(p).transparent() )
+            v.push_back( p );
+    }
+    return v;
+}
+
+void bench_fov( size_t w, size_t h, int radius )
+{
+    Grid<Tile> g;
+    random_map( g, w, h );
+    std::vector< Vec > origins = sample_floors( g, 256 );
+    const unsigned int N = 2000;
+
+    char name[64];
+
+    BitPlane plane( w, h );
+    snprintf( name, sizeof name, "fov/shadowcast/r%d", radius );
+    report( name, g, time_ns( N, [&]( unsigned int i ) { 
+        compute_fov( g, origins[i % origins.size()], radius, plane );
+    }) );
+
+    // libtcod, plus reading the result back out per tile, as the game did.
+    TCODMap map( w, h );
+    for( size_t y=0; y < h; y++ )
+        for( size_t x=0; x < w; x++ ) {
+            bool t = g.get(x,y).transparent();
+            map.setProperties( x, y, t, t );
+        }
+
+    snprintf( name, sizeof name, "fov/libtcod-permissive4/r%d", radius );
+    report( name, g, time_ns( N, [&]( unsigned int i ) { 
+        const Vec& o = origins[ i % origins.size() ];
+        map.computeFov( o.x(), o.y(), radius, true, FOV_PERMISSIVE_4 );
+        for( size_t y=0; y < h; y++ )
+            for( size_t x=0; x < w; x++ )
+                plane.set( x, y, map.isInFov(x, y) );
+    }) );
+}
+
+/* A player's path: n single steps over floor, from a random start. */
+std::vector< Vec > random_walk( const Grid<Tile>& g, size_t n )
+{
+    const Vec DIRS[] = {
+        Vec(-1,-1), Vec(0,-1), Vec(1,-1), Vec(1,0),
+        Vec(1,1), Vec(0,1), Vec(-1,1), Vec(-1,0)
+    };
+
+    std::vector< Vec > walk;
+    while( walk.size() < n ) {
+        if( walk.empty() )
+            walk.push_back( sample_floors(g, 1)[0] );
+
+        // Try a few directions; start over if boxed in.
+        Vec next = walk.back();
+        for( int tries=0; tries < 16 and next == walk.back(); tries++ ) {
+            Vec p = walk.back() + DIRS[ random(0, 7) ];
+            if( g.get(p).walkable() )
+                next = p;
+        }
+
+        if( next == walk.back() )
+            walk.clear();
+        else
+            walk.push_back( next );
+    }
+    return walk;
+}
+
+void bench_distance( size_t w, size_t h, int radius )
+{
+    Grid<Tile> g;
+    random_map( g, w, h );
+    std::vector< Vec > walk = random_walk( g, 512 );
+    const unsigned int N = w*h > 100000 ? 50 : 2000;
+
+    char name[64];
+
+    DistanceMap dm( w, h, radius );
+    snprintf( name, sizeof name, "distance/full/r%d", radius );
+    report( name, g, time_ns( N, [&]( unsigned int i ) { 
+        dm.compute( g, walk[i % walk.size()] );
+    }) );
+
+    // Every step is a single one, except going back to the start.
+    dm.compute( g, walk[0] );
+    snprintf( name, sizeof name, "distance/incremental/r%d", radius );
+    report( name, g, time_ns( N, [&]( unsigned int i ) { 
+        dm.move_root( g, walk[i % walk.size()] );
+    }) );
+
+    dm.set_radius( w + h );
+    snprintf( name, sizeof name, "distance/full/unbounded" );
+    report( name, g, time_ns( N, [&]( unsigned int i ) { 
+        dm.compute( g, walk[i % walk.size()] );
+    }) );
+
+    dm.compute( g, walk[0] );
+    snprintf( name, sizeof name, "distance/incremental/unbounded" );
+    report( name, g, time_ns( N, [&]( unsigned int i ) { 
+        dm.move_root( g, walk[i % walk.size()] );
+    }) );
+
+    // libtcod's Dijkstra, as the game used to do every move.
+    TCODMap map( w, h );
+    for( size_t y=0; y < h; y++ )
+        for( size_t x=0; x < w; x++ ) {
+            bool t = g.get(x,y).walkable();
+            map.setProperties( x, y, t, t );
+        }
+
+    TCODDijkstra dijkstra( &map );
+    snprintf( name, sizeof name, "distance/libtcod/unbounded" );
+    report( name, g, time_ns( N, [&]( unsigned int i ) { 
+        const Vec& o = walk[ i % walk.size() ];
+        dijkstra.compute( o.x(), o.y() );
+    }) );
+}
+
+void bench_grid( size_t w, size_t h )
+{
+    const unsigned int N = w*h > 100000 ? 20 : 2000;
+    volatile int sink = 0;
+
+    Grid<char> g( w, h, '.' );
+    report( "grid/construct", g, time_ns( N, [&]( unsigned int ) {
+        Grid<char> fresh( w, h, '#' );
+        sink = sink + fresh.get( 0, 0 );
+    }) );
+
+    // Per tile visited.
+    report( "grid/row_begin", g, time_ns( N, [&]( unsigned int ) {
+        int n = 0;
+        for( size_t y=0; y < h; y++ )
+            n += std::count( g.row_begin(y), g.row_end(y), '.' );
+        sink = sink + n;
+    }) / g.area() );
+
+    report( "grid/col_begin", g, time_ns( N, [&]( unsigned int ) {
+        int n = 0;
+        for( size_t x=0; x < w; x++ )
+            n += std::count( g.col_begin(x), g.col_end(x), '.' );
+        sink = sink + n;
+    }) / g.area() );
+
+    // A room the size of the player's view.
+    Room r( w/2 - 10, w/2 + 10, h/2 - 10, h/2 + 10 );
+    size_t roomArea = 21 * 21;
+    report( "grid/reg_begin", g, time_ns( N * 10, [&]( unsigned int ) {
+        sink = sink + std::count( g.reg_begin(r), g.reg_end(r), '.' );
+    }) / roomArea );
+}
+
+/*
+ * Make the game's current level a w by h one, with an actor or item on about
+ * density of its floor tiles. As the game does, with the dungeon's own
+ * generator, but with more spawns.
+ */
+void enter_bench_level( size_t w, size_t h, double density )
+{
+    dungeon.start( 1, w, h, []( Grid<Tile>& g ) { 
+        return generate_bsp( g, 5, 16 ); 
+    } );
+    Level level = dungeon.next();
+    dungeon.stop();
+
+    std::vector< Vec > floors;
+    for( size_t y=0; y < h; y++ )
+        for( size_t x=0; x < w; x++ )
+            if( level.grid.get(x,y).walkable() and Vec(x,y) != level.entrance )
+                floors.push_back( Vec(x,y) );
+
+    level.monsters.clear();
+    level.items.clear();
+    for( const Vec& p : floors ) {
+        if( random(0, 999) < density * 1000 )
+            level.monsters.push_back( Spawn{ p, ThingId(random(0, 2)), 1 } );
+        if( random(0, 999) < density * 1000 )
+            level.items.push_back( Spawn{ p, 1, 0 } );
+    }
+
+    enter_level( std::move(level) );
+}
+
+void bench_lookup( size_t w, size_t h, double density )
+{
+    enter_bench_level( w, h, density );
+
+    std::vector< Vec > probes;
+    for( int i=0; i < 4096; i++ )
+        probes.push_back( Vec(random(0, w-1), random(0, h-1)) );
+
+    const unsigned int N = 1000000;
+    volatile int sink = 0;
+    char name[64];
+
+    snprintf( name, sizeof name, "lookup/actor_at/%g", density );
+    report( name, grid, time_ns( N, [&]( unsigned int i ) {
+        sink = sink + (actor_at( probes[i % probes.size()] ) != NOBODY);
+    }) );
+
+    snprintf( name, sizeof name, "lookup/item_at/%g", density );
+    report( name, grid, time_ns( N, [&]( unsigned int i ) {
+        sink = sink + (item_at( probes[i % probes.size()] ) != items.end());
+    }) );
+}
+
+void bench_turn( size_t w, size_t h )
+{
+    enter_bench_level( w, h, 0.05 );
+    std::vector< Vec > walk = random_walk( grid, 512 );
+    const unsigned int N = 2000;
+    volatile int sink = 0;
+
+    // The player walks; fov, distances and the dirty cells follow.
+    report( "game/update_map", grid, time_ns( N, [&]( unsigned int i ) {
+        const Vec& p = walk[ i % walk.size() ];
+        if( actor_at(p) == NOBODY )
+            move_actor( player, p );
+        update_map( player.pos() );
+    }) );
+
+    // Per monster, seen or not.
+    std::vector< Actor > monsters;
+    for( size_t i=0; i < actors.size(); i++ )
+        if( actors[i] != player )
+            monsters.push_back( actors[i] );
+
+    report( "game/move_monst", grid, time_ns( N * 10, [&]( unsigned int i ) {
+        Action a = move_monst( monsters[ i % monsters.size() ] );
+        sink = sink + a.type;
+    }) );
+
+    // The same two fight on and on; the victim never dies.
+    Actor aggressor = monsters[0], victim = monsters[1];
+    report( "game/attack", grid, time_ns( N * 100, [&]( unsigned int ) {
+        attack( aggressor, victim );
+        victim.hp() = victim.stats()[HP];
+    }) );
+}
+
+void bench_msg()
+{
+    const unsigned int N = 100000;
+
+    // A screenful: print a few messages and show them, as every turn might.
+    report( "msg/for_each", time_ns( N, [&]( unsigned int i ) {
+        for( int m=0; m < 4; m++ )
+            msg::normal( "You see the kobold grab a stick (%u).", i );
+        size_t len = 0;
+        msg::for_each( [&]( const msg::Message& m ) { len += m.len; } );
+    }) );
+}
+
+void bench_render()
+{
+    // Only at the screen's size, unlike the cases above: render() draws onto
+    // screen and overlay, and the scratch consoles, which are all made once
+    // at mapDims. A bigger map would need them all resized with the level.
+    enter_bench_level( mapDims.x(), mapDims.y(), 0.05 );
+    std::vector< Vec > walk = random_walk( grid, 512 );
+    const unsigned int N = 1000;
+
+    report( "render/full", grid, time_ns( N, [&]( unsigned int ) {
+        redraw_all();
+        render();
+    }) );
+
+    // What a step usually costs: only what changed is drawn.
+    auto step = [&]( unsigned int i ) {
+        const Vec& p = walk[ i % walk.size() ];
+        if( actor_at(p) == NOBODY )
+            move_actor( player, p );
+        update_map( player.pos() );
+        render();
+    };
+    report( "render/step", grid, time_ns( N, step ) );
+
+    // Once warmed up, a frame must not allocate: not with messages to show,
+    // nor with the perf panel up. The steps above were the warm-up.
+    perf::toggle();
+    alloc::Count before = alloc::total();
+    for( unsigned int i=0; i < N; i++ ) {
+        msg::normal( "Step %u.", i );
+        step( i );
+    }
+    alloc::Count allocated = alloc::total() - before;
+    perf::toggle();
+
+    if( allocated.allocs ) {
+        fprintf( stderr, "render: %lu allocations (%lu bytes) in %u frames; "
+                 "there should be none.\n", 
+                 allocated.allocs, allocated.bytes, N );
+        exit( 1 );
+    }
+}
+
+void bench_bsp( size_t w, size_t h )
+{
+    Grid<Tile> g( w, h, '#' );
+    report( "mapgen/bsp", g, time_ns( 2000, [&]( unsigned int ) {
+        generate_bsp( g, 5, 15 );
+    }) );
+}
+
+void bench_rng()
+{
+    const unsigned int N = 1000000;
+    const int MAX = 1000;
+
+    // Keep results alive so the loops can't be optimized away.
+    volatile int sink = 0;
+
+    srand( 1 );
+    report( "rng/rand-mod", time_ns( N, [&]( unsigned int ) {
+        sink = sink + rand() % MAX;
+    }) );
+
+    Rng r( 1 );
+    report( "rng/range", time_ns( N, [&]( unsigned int ) {
+        sink = sink + r.range( 0, MAX-1 );
+    }) );
+
+    // Per number, in batches of 4096.
+    std::vector< int > batch( 4096 );
+    report( "rng/fill", time_ns( N / batch.size(), [&]( unsigned int ) {
+        r.fill( batch.data(), batch.size(), 0, MAX-1 );
+        sink = sink + batch.back();
+    }) / batch.size() );
+}
+
+void bench_attack()
+{
+    const unsigned int N = 1000000;
+    volatile int sink = 0;
+
+    // About a human with a stick against a kobold.
+    Stats human  = Stats{{ 20, 20, 15, 10, 18, 5 }};
+    Stats kobold = Stats{{ 10,  7, 20, 18, 15, 0 }};
+
+    Rng dice( 1 );
+    report( "attack/roll", time_ns( N, [&]( unsigned int ) {
+        sink = sink + roll_attack( human, kobold, dice ).damage;
+    }) );
+
+    // Refreshing cached stats: base plus weapon, per actor.
+    std::vector< Stats > base( 1024, kobold ), derived( base.size() );
+    report( "attack/stats-sum", time_ns( N / base.size(), [&]( unsigned int ) {
+        for( size_t i=0; i < base.size(); i++ )
+            derived[i] = base[i] + human;
+        sink = sink + derived.back()[HP];
+    }) / base.size() );
+}
+
+int main()
+{
+    // The same maps and samples every run.
+    reseed( 1 );
+
+    printf( "benchmark,width,height,ns_per_op\n" );
+
+    bench_rng();
+    bench_attack();
+
+    bench_fov( 80, 60, 10 );
+    bench_fov( 200, 200, 10 );
+    bench_fov( 200, 200, 40 );
+
+    bench_distance( 80, 60, 20 );
+    bench_distance( 1000, 1000, 20 );
+
+    bench_bsp( 80, 60 );
+
+    bench_grid( 80, 60 );
+    bench_grid( 1000, 1000 );
+
+    // The game's own state, driven as main() does but without a window.
+    headless = true;
+    window = false;
+    playerName = "bench";
+    screen = new TCODConsole( mapDims.x(), mapDims.y() );
+    init_palette();
+
+    for( double density : { 0.01, 0.1, 0.5 } ) {
+        bench_lookup( 80, 60, density );
+        bench_lookup( 200, 200, density );
+    }
+
+    bench_turn( 80, 60 );
+    bench_turn( 200, 200 );
+
+    bench_msg();
+    bench_render();
+}
@@ -0,0 +1,95 @@
+
+#include "bsp.h"
+#include "random.h"
+#include "trace.h"
+
+#include <algorithm>
+
+namespace
+{
+
+const char WALL  = '#';
+const char FLOOR = '.';
+
+unsigned int width( const Room& r )  { return r.right - r.left + 1; }
+unsigned int height( const Room& r ) { return r.down - r.up + 1; }
+
+// Dig out a room of random size somewhere inside r.
+Room dig_room( Grid<Tile>& grid, const Room& r )
+{
+    unsigned int minW = std::min( width(r),  unsigned(Room::MINLEN) );
+    unsigned int minH = std::min( height(r), unsigned(Room::MINLEN) );
+    Rng& dice = rng( MAPGEN );
+    unsigned int w = dice.range( minW, width(r) );
+    unsigned int h = dice.range( minH, height(r) );
+
+    unsigned int left = dice.range( r.left, r.right - w + 1 );
+    unsigned int up   = dice.range( r.up,   r.down  - h + 1 );
+    Room room( left, left + w - 1, up, up + h - 1 );
+
+    for( unsigned int y = room.up; y <= room.down; y++ )
+        std::fill( grid.row_begin(y) + room.left, 
+                   grid.row_begin(y) + room.right + 1, FLOOR );
+    return room;
+}
+
+// Dig an L-shaped corridor: along a's row, then along b's column.
+void dig_corridor( Grid<Tile>& grid, const Vec& a, const Vec& b )
+{
+    int dx = a.x() < b.x() ? 1 : -1;
+    for( int x = a.x(); x != b.x(); x += dx )
+        grid.get( x, a.y() ).c = FLOOR;
+
+    int dy = a.y() < b.y() ? 1 : -1;
+    for( int y = a.y(); y != b.y(); y += dy )
+        grid.get( b.x(), y ).c = FLOOR;
+    grid.get( b ).c = FLOOR;
+}
+
+// Partition r, dig its rooms and return a floor tile in one of them.
+Vec partition( Grid<Tile>& grid, const Room& r, int depth )
+{
+    // Split across the longer side, if both halves can hold a room.
+    bool wide = width(r) > height(r);
+    unsigned int span = wide ? width(r) : height(r);
+
+    if( depth <= 0 or span < unsigned(2*Room::MINLEN + 1) ) {
+        Room room = dig_room( grid, r );
+        return Vec( rng(MAPGEN).range(room.left, room.right), 
+                    rng(MAPGEN).range(room.up,   room.down) );
+    }
+
+    std::pair<Room,Room> halves = wide ? vsplit( r, Room::MINLEN ) 
+                                       : hsplit( r, Room::MINLEN );
+
+    Vec a = partition( grid, halves.first,  depth-1 );
+    Vec b = partition( grid, halves.second, depth-1 );
+    dig_corridor( grid, a, b );
+
+    return rng( MAPGEN ).below( 2 ) ? a : b;
+}
+
+} // namespace
+
+std::vector< Vec > generate_bsp( Grid<Tile>& grid, int depth, 
+                                 unsigned int nSpawns )
+{
+    TRACE_SCOPE( "generate_bsp" );
+
+    std::fill_n( grid.tiles, grid.area(), WALL );
+    partition( grid, Room(1, grid.width-2, 1, grid.height-2), depth );
+
+    std::vector< Vec > floors;
+    for( unsigned int y=1; y < grid.height-1; y++ )
+        for( unsigned int x=1; x < grid.width-1; x++ )
+            if( grid.get(x,y).c == FLOOR )
+                floors.push_back( Vec(x,y) );
+
+    // Shuffle only as far as needed.
+    nSpawns = std::min( nSpawns, unsigned(floors.size()) );
+    for( unsigned int i=0; i < nSpawns; i++ )
+        std::swap( floors[i], floors[ i + rng(MAPGEN).below(floors.size()-i) ] );
+    floors.resize( nSpawns );
+
+    return floors;
+}
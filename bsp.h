@@ -0,0 +1,17 @@
+
+#pragma once
+
+#include "Rogue.h"
+
+#include <vector>
+
+/*
+ * Binary space partitioning dungeon generator.
+ * Fill grid with wall, then split it (leaving a wall border) with hsplit and
+ * vsplit up to depth times, dig a room into every part and join each pair of
+ * halves with a corridor, so every floor tile can reach every other.
+ *
+ * Returns up to nSpawns distinct floor tiles, in random order.
+ */
+std::vector< Vec > generate_bsp( Grid<Tile>& grid, int depth, 
+                                 unsigned int nSpawns );
@@ -0,0 +1,27 @@
+
+#include "combat.h"
+
+Blow roll_attack( const Stats& as, const Stats& vs, Rng& dice )
+{
+    // Victim can move out of the way before before aggressor attacks.
+    if( dice.range(1, as[AGILITY]*as[ACCURACY]) < as[AGILITY]+as[DEXTERITY] ) 
+        return Blow{ MISSED, 0 };
+
+    // Victim can dodge aggressor's attack.
+    if( dice.range(1, vs[AGILITY]+vs[DEXTERITY]) > as[DEXTERITY] )
+        return Blow{ DODGED, 0 };
+
+    int dmg = dice.range( as[STRENGTH]/2, as[STRENGTH]+1 );
+    if( dmg >= as[STRENGTH] )
+        return Blow{ CRITICAL, int(dmg * 1.5f) };
+    return Blow{ HIT, dmg };
+}
+
+AttackResult land( const Blow& blow, int& hp )
+{
+    if( blow.result < HIT )
+        return blow.result;
+
+    hp -= blow.damage;
+    return hp < 1 ? KILLED : blow.result;
+}
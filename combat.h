@@ -0,0 +1,23 @@
+
+#pragma once
+
+#include "Actor.h" // For Stats.
+#include "random.h"
+
+/* How an attack went, from worst to best for the aggressor. */
+enum AttackResult { MISSED, DODGED, HIT, CRITICAL, KILLED };
+
+struct Blow
+{
+    AttackResult result; // Never KILLED; that depends on the victim's hp.
+    int damage;
+};
+
+/*
+ * Roll an attack by a fighter with stats as on one with stats vs, using
+ * dice. Touches nothing else, so fights can be simulated on any thread.
+ */
+Blow roll_attack( const Stats& as, const Stats& vs, Rng& dice );
+
+/* Take blow's damage off the victim's hp; KILLED if that leaves it below 1. */
+AttackResult land( const Blow& blow, int& hp );
@@ -0,0 +1,217 @@
+
+#include "Actor.h"
+#include "combat.h"
+#include "random.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <thread>
+#include <atomic>
+#include <chrono>
+
+#include <unistd.h> // For getopt.
+
+/*
+ * Combat balance, measured: every race, wielding every item, fights every
+ * other many times over with the game's own attack rolls. Prints one CSV
+ * line per matchup.
+ *
+ * Matchups are shared out among threads. Each rolls its own dice, seeded
+ * from the seed and the matchup, so the numbers don't depend on how many threads ran.
+ */
+
+// A duel neither side can win is called a draw after this many attacks.
+const int MAX_ATTACKS = 1000;
+
+// Blows doing more than this count as this much in the histogram.
+const int MAX_DAMAGE = 255;
+
+struct Fighter
+{
+    ThingId race, weapon;
+    Stats stats; // As in the game: race plus weapon.
+
+    std::string name() const
+    { return std::string(races[race].name) + "+" + catalogue[weapon].name; }
+};
+
+/* Everything that happened over all duels of one matchup. */
+struct Tally
+{
+    unsigned long wins[2], draws;
+    unsigned long attacks[2], hits[2];
+
+    // How many attacks the winner made, and how hard each hit was.
+    std::vector< unsigned long > toKill;
+    std::vector< unsigned long > damage[2];
+
+    Tally() : toKill( MAX_ATTACKS + 1 )
+    {
+        wins[0] = wins[1] = draws = 0;
+        attacks[0] = attacks[1] = hits[0] = hits[1] = 0;
+        damage[0].resize( MAX_DAMAGE + 1 );
+        damage[1].resize( MAX_DAMAGE + 1 );
+    }
+};
+
+/* Fight it out. first strikes first when both are ready at once. */
+void duel( const Fighter& f0, const Fighter& f1, int first,
+           Rng& dice, Tally& t )
+{
+    const Fighter* f[2] = { &f0, &f1 };
+    int hp[2]   = { f0.stats[HP], f1.stats[HP] };
+    int next[2] = { 0, 0 };  // As Actor::nextMove().
+    int made[2] = { 0, 0 };
+
+    while( made[0] + made[1] < MAX_ATTACKS ) {
+        int a = next[first] <= next[1-first] ? first : 1-first;
+        int v = 1 - a;
+
+        Blow blow = roll_attack( f[a]->stats, f[v]->stats, dice );
+        made[a]++;
+        t.attacks[a]++;
+        if( blow.result >= HIT ) {
+            t.hits[a]++;
+            t.damage[a][ std::min(std::max(blow.damage, 0), MAX_DAMAGE) ]++;
+        }
+
+        if( land(blow, hp[v]) == KILLED ) {
+            t.wins[a]++;
+            t.toKill[ made[a] ]++;
+            return;
+        }
+
+        next[a] += 50 - f[a]->stats[AGILITY];
+    }
+
+    t.draws++;
+}
+
+/* The smallest value at or above the p'th quantile of histogram h. */
+size_t quantile( const std::vector< unsigned long >& h, double p )
+{
+    unsigned long total = 0;
+    for( unsigned long n : h )
+        total += n;
+
+    unsigned long seen = 0;
+    for( size_t i=0; i < h.size(); i++ ) {
+        seen += h[i];
+        if( seen and seen >= p * total )
+            return i;
+    }
+    return 0;
+}
+
+double mean( const std::vector< unsigned long >& h )
+{
+    double sum = 0, n = 0;
+    for( size_t i=0; i < h.size(); i++ ) {
+        sum += double(i) * h[i];
+        n   += h[i];
+    }
+    return n ? sum / n : 0;
+}
+
+int main( int argc, char** argv )
+{
+    unsigned long nDuels = 100000;
+    unsigned long seed = 1;
+    unsigned int nThreads = std::thread::hardware_concurrency();
+
+    int opt;
+    while( (opt = getopt(argc, argv, "n:s:j:")) != -1 ) {
+        switch( opt ) {
+          case 'n': nDuels = strtoul( optarg, 0, 10 ); break;
+          case 's': seed = strtoul( optarg, 0, 10 ); break;
+          case 'j': nThreads = strtoul( optarg, 0, 10 ); break;
+          default:
+            fprintf( stderr,
+                     "usage: %s [-n duels] [-s seed] [-j threads]\n"
+                     "  -n  Duels per matchup (100000 by default).\n"
+                     "  -s  Seed the dice.\n"
+                     "  -j  Threads to fight on (all cores by default).\n",
+                     argv[0] );
+            return 1;
+        }
+    }
+    nThreads = std::max( nThreads, 1u );
+
+    // Every race with everything it could wield, but a corpse.
+    std::vector< Fighter > fighters;
+    for( ThingId r=0; r < races.size(); r++ )
+        for( ThingId w=0; w < catalogue.size(); w++ )
+            if( w != CORPSE_ID )
+                fighters.push_back(
+                    Fighter{ r, w, races[r].stats + catalogue[w].stats } );
+
+    // Each pair once, and each against itself to show the first-strike bias
+    // cancels out.
+    std::vector< std::pair<size_t,size_t> > matchups;
+    for( size_t i=0; i < fighters.size(); i++ )
+        for( size_t j=i; j < fighters.size(); j++ )
+            matchups.emplace_back( i, j );
+
+    std::vector< Tally > tallies( matchups.size() );
+    std::atomic< size_t > nextMatchup( 0 );
+
+    auto work = [&]() {
+        size_t m;
+        while( (m = nextMatchup++) < matchups.size() ) {
+            // Mixed, so that matchup m+1 under seed S doesn't roll what
+            // matchup m did under S+1.
+            Rng dice( rng_detail::splitmix(seed, m) );
+            const Fighter& a = fighters[ matchups[m].first ];
+            const Fighter& b = fighters[ matchups[m].second ];
+
+            // Tally apart from the others, whose counters may share a cache
+            // line with ours.
+            Tally t;
+            for( unsigned long d=0; d < nDuels; d++ )
+                duel( a, b, d % 2, dice, t );
+            tallies[m] = std::move( t );
+        }
+    };
+
+    auto start = std::chrono::steady_clock::now();
+
+    std::vector< std::thread > threads;
+    for( unsigned int i=0; i < nThreads; i++ )
+        threads.emplace_back( work );
+    for( std::thread& t : threads )
+        t.join();
+
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+
+    printf( "a,b,duels,a_wins,b_wins,draws,attacks_to_kill_mean,"
+            "attacks_to_kill_p50,attacks_to_kill_p90,"
+            "a_hit_rate,a_damage_mean,a_damage_p90,"
+            "b_hit_rate,b_damage_mean,b_damage_p90\n" );
+
+    for( size_t m=0; m < matchups.size(); m++ ) {
+        const Tally& t = tallies[m];
+        double n = nDuels;
+
+        printf( "%s,%s,%lu,%.4f,%.4f,%.4f,%.2f,%zu,%zu",
+                fighters[ matchups[m].first ].name().c_str(),
+                fighters[ matchups[m].second ].name().c_str(), nDuels,
+                t.wins[0] / n, t.wins[1] / n, t.draws / n,
+                mean(t.toKill), quantile(t.toKill, 0.5),
+                quantile(t.toKill, 0.9) );
+
+        for( int s=0; s < 2; s++ )
+            printf( ",%.4f,%.2f,%zu",
+                    t.attacks[s] ? double(t.hits[s]) / t.attacks[s] : 0.0,
+                    mean(t.damage[s]), quantile(t.damage[s], 0.9) );
+        printf( "\n" );
+    }
+
+    double total = double(nDuels) * matchups.size();
+    fprintf( stderr, "%.0f duels in %.3fs on %u threads: %.0f duels/s.\n",
+             total, elapsed.count(), nThreads,
+             elapsed.count() > 0 ? total / elapsed.count() : 0.0 );
+}
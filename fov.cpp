@@ -0,0 +1,128 @@
+
+#include "fov.h"
+
+/*
+ * Based on Albert Ford's "Symmetric Shadowcasting". The view is split into
+ * four quadrants (north, south, east, west). Each one is scanned row by row,
+ * moving away from the origin, and every row is limited by a start and end
+ * slope. Slopes are kept as exact fractions, so there is no floating point
+ * to disagree with itself.
+ */
+
+namespace
+{
+
+struct Slope
+{
+    int num, den; // den > 0
+};
+
+// In a quadrant, the tile at (depth, col) lies at
+//      origin + col * (colX, colY) + depth * (depthX, depthY).
+struct Quadrant
+{
+    int colX, colY, depthX, depthY;
+};
+
+const Quadrant QUADRANTS[] = {
+    { 1, 0,  0, -1 }, // North
+    { 1, 0,  0, +1 }, // South
+    { 0, 1, +1,  0 }, // East
+    { 0, 1, -1,  0 }  // West
+};
+
+int floor_div( int a, int b ) { return a >= 0 ? a / b : -((-a + b - 1) / b); }
+int ceil_div( int a, int b )  { return -floor_div( -a, b ); }
+
+struct Caster
+{
+    const Grid<Tile>& grid;
+    const Vec origin;
+    const int radius;
+    BitPlane& out;
+    Quadrant q;
+
+    Caster( const Grid<Tile>& g, const Vec& o, int r, BitPlane& out )
+        : grid( g ), origin( o ), radius( r ), out( out )
+    {
+    }
+
+    int x( int depth, int col ) const
+    { return origin.x() + col*q.colX + depth*q.depthX; }
+    int y( int depth, int col ) const
+    { return origin.y() + col*q.colY + depth*q.depthY; }
+
+    bool on_grid( int x, int y ) const
+    {
+        return x >= 0 and y >= 0 and x < int(grid.width) and y < int(grid.height);
+    }
+
+    // Off the grid counts as a wall.
+    bool opaque( int depth, int col ) const
+    {
+        int tx = x( depth, col ), ty = y( depth, col );
+        return not on_grid(tx, ty) or not grid.get(tx, ty).transparent();
+    }
+
+    void reveal( int depth, int col )
+    {
+        int tx = x( depth, col ), ty = y( depth, col );
+        if( on_grid(tx, ty) and col*col + depth*depth <= radius*radius )
+            out.set( tx, ty );
+    }
+
+    // The slope of the tile's near edge.
+    static Slope slope( int depth, int col )
+    { return Slope{ 2*col - 1, 2*depth }; }
+
+    // A floor tile is only visible if its center is within the row's slopes;
+    // that's what keeps sight symmetric.
+    static bool symmetric( int depth, int col, Slope start, Slope end )
+    {
+        return col * start.den >= depth * start.num
+           and col * end.den   <= depth * end.num;
+    }
+
+    void scan( int depth, Slope start, Slope end )
+    {
+        if( depth > radius )
+            return;
+
+        // Round depth*start up on ties and depth*end down.
+        int minCol = floor_div( 2*depth*start.num + start.den, 2*start.den );
+        int maxCol = ceil_div( 2*depth*end.num - end.den, 2*end.den );
+
+        enum { NONE, FLOOR, WALL } prev = NONE;
+        for( int col = minCol; col <= maxCol; col++ ) {
+            bool wall = opaque( depth, col );
+
+            if( wall or symmetric(depth, col, start, end) )
+                reveal( depth, col );
+
+            if( prev == WALL and not wall )
+                start = slope( depth, col );
+            if( prev == FLOOR and wall )
+                scan( depth+1, start, slope(depth, col) );
+
+            prev = wall ? WALL : FLOOR;
+        }
+
+        if( prev == FLOOR )
+            scan( depth+1, start, end );
+    }
+};
+
+} // namespace
+
+void compute_fov( const Grid<Tile>& grid, const Vec& origin, int radius,
+                  BitPlane& out )
+{
+    out.clear();
+    out.set( origin.x(), origin.y() );
+
+    Caster caster( grid, origin, radius, out );
+    for( const Quadrant& q : QUADRANTS ) {
+        caster.q = q;
+        caster.scan( 1, Slope{-1, 1}, Slope{1, 1} );
+    }
+}
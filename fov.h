@@ -0,0 +1,14 @@
+
+#pragma once
+
+#include "Rogue.h"
+#include "BitPlane.h"
+
+/*
+ * Symmetric shadowcasting.
+ * Set the bit in out for every tile of grid visible from origin, within
+ * radius. Walls are visible but block sight; sight is symmetric (if A can see
+ * B, B can see A). out must be the same size as grid; it is cleared first.
+ */
+void compute_fov( const Grid<Tile>& grid, const Vec& origin, int radius,
+                  BitPlane& out );
@@ -0,0 +1,1248 @@
+
+#include "Vector.h"
+#include "Pure.h"
+#include "Grid.h"
+#include "random.h"
+#include "msg.h"
+#include "Scheduler.h"
+#include "Actor.h"
+#include "BitPlane.h"
+#include "fov.h"
+#include "DistanceMap.h"
+#include "bsp.h"
+#include "Dungeon.h"
+#include "record.h"
+#include "zobrist.h"
+#include "combat.h"
+#include "game.h"
+#include "trace.h"
+#include "perf.h"
+#include "alloc.h"
+
+#include "Rogue.h"
+
+#include "libtcod.hpp"
+
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include <memory>
+#include <list>
+#include <string>
+#include <chrono>
+#include <ctime>
+#include <thread>
+
+Vec mapDims( 80, 60 );
+
+Grid<Tile> grid( 80, 60, '#' );
+
+Dungeon dungeon;
+
+uint64_t stateHash = 0;
+std::vector< uint64_t > actorHash;
+
+FILE* hashLog = 0;
+
+ActorStore actors;
+ItemList   items;
+
+Grid< Actor > actorGrid( grid.width, grid.height, NOBODY );
+Grid< ItemList::iterator >  itemGrid( grid.width, grid.height, 
+                                      std::end(items) );
+
+Actor player = NOBODY;
+std::string playerName;
+
+Scheduler< Actor, TurnSlot > turns;
+
+BitPlane fov( grid.width, grid.height );
+DistanceMap playerDistance( grid.width, grid.height, PATH_RADIUS );
+
+TCODConsole* screen = 0;
+
+bool headless = false;
+bool replaying = false;
+int watchDelay = -1;
+bool window = true;
+bool rendering = true;
+bool externalMapgen = false;
+
+TCODConsole overlay( grid.width, grid.height );
+
+/*
+ * Scratch consoles the UI is printed onto before going on the overlay. Each
+ * is made once, at the largest it can need to be, so that drawing a frame
+ * never allocates.
+ */
+const int INFO_LEN = 20; // Longest line the look mode prints.
+const int PERF_WIDTH = 26;
+TCODConsole msgbox( grid.width / 2, 1 );
+TCODConsole infobox( INFO_LEN, 1 );
+TCODConsole invcons( grid.width / 2, grid.height );
+TCODConsole perfPanel( PERF_WIDTH, perf::N_PHASES + 3 );
+
+/* 
+ * Cells of the map whose visibility, highlight, glyph or occupant changed
+ * since the last render(). Only these get redrawn; the flag in dirty keeps a
+ * cell from being queued twice.
+ */
+Grid< bool > dirty( grid.width, grid.height, true );
+std::vector< Vec > dirtyCells;
+
+/* 
+ * Regions of overlay written to this frame, and those blitted onto screen
+ * last frame, which must be redrawn from the map.
+ */
+std::vector< Room > overlayRegions, overlayShown;
+
+/* Queue a cell, or every cell in a region, for redrawing. */
+void mark_dirty( const Vec& pos );
+void mark_dirty( const Room& r );
+
+/* Note that r of overlay has been drawn on and must be shown. */
+void mark_overlay( const Room& r );
+
+/* Blit src onto overlay at (x,y), noting the region. */
+void overlay_blit( const TCODConsole* src, int w, int h, int x, int y,
+                   float fgAlpha=1, float bgAlpha=1 );
+
+/* Highlight the tile at pos for the next render(). */
+void highlight( const Vec& pos );
+
+/* Copy fov into grid's VISIBLE flags, and add it to SEEN. */
+void update_visibility();
+
+/* Adjust vec to keep it on screen. */
+Vec keep_inside( const TCODConsole&, Vec );
+
+/*
+ * Wait for the next pressed key. 
+ * Do not return on key lift. Convert number/keypad input to '0'-'9'.
+ */
+int next_pressed_key();
+
+/* True if the tile at pos blocks movement. */
+bool blocked( const Vec& pos );
+
+/*
+ * The colors of each kind of tile, once discovered, by whether it is
+ * visible and whether it is highlighted. Filled once by init_palette(), so
+ * draw_cell() only has to look them up.
+ */
+struct TileLook
+{
+    TCODColor fg, bg;
+};
+
+enum { LOOK_REMEMBERED, LOOK_VISIBLE, LOOK_LIT_REMEMBERED, LOOK_LIT_VISIBLE,
+       N_LOOKS };
+
+TileLook palette[ N_TILE_KINDS ][ N_LOOKS ];
+
+/* The eight steps to a neighbouring tile. */
+const Vec DIRS[] = {
+    Vec(-1,-1), Vec(0,-1), Vec(+1,-1), Vec(+1,0),
+    Vec(+1,+1), Vec(0,+1), Vec(-1,+1), Vec(-1,0)
+};
+
+/* Inventory Index to Char. */
+char iitoc( unsigned int i ) { return 'a' + i; }
+/* Char to Inventory Index. */
+unsigned int ctoii( char c ) { return c - 'a'; }
+
+Actor actor_at( const Vec& pos )
+{
+    return on_map(pos) ? actorGrid.get( pos ) : NOBODY;
+}
+
+ItemList::iterator item_at( const Vec& pos )
+{
+    return on_map(pos) ? itemGrid.get( pos ) : std::end( items );
+}
+
+void place_actor( Actor actor )
+{
+    actorGrid.get( actor.pos() ) = actor;
+    mark_dirty( actor.pos() );
+}
+
+void move_actor( Actor actor, const Vec& pos )
+{
+    actorGrid.get( actor.pos() ) = NOBODY;
+    mark_dirty( actor.pos() );
+    actor.pos() = pos;
+    actorGrid.get( actor.pos() ) = actor;
+    mark_dirty( actor.pos() );
+}
+
+/* What actor adds to stateHash. */
+uint64_t hash_actor( Actor actor )
+{
+    using namespace zobrist;
+    return key( ACTOR_POS,  actor.id, pack(actor.pos()) )
+         + key( ACTOR_HP,   actor.id, actor.hp() )
+         + key( ACTOR_NEXT, actor.id, actor.nextMove() )
+         + key( ACTOR_RACE, actor.id, actor.race() );
+}
+
+void rehash_actor( Actor actor )
+{
+    if( actor.id >= actorHash.size() )
+        actorHash.resize( actor.id + 1, 0 );
+
+    stateHash -= actorHash[ actor.id ];
+    actorHash[ actor.id ] = hash_actor( actor );
+    stateHash += actorHash[ actor.id ];
+}
+
+uint64_t hash_item( const MapItem& item )
+{
+    return zobrist::key( zobrist::ITEM, item.id, zobrist::pack(item.pos) );
+}
+
+void remove_actor( Actor actor )
+{
+    if( actor.id < actorHash.size() ) {
+        stateHash -= actorHash[ actor.id ];
+        actorHash[ actor.id ] = 0;
+    }
+
+    if( actorGrid.get(actor.pos()) == actor )
+        actorGrid.get( actor.pos() ) = NOBODY;
+    mark_dirty( actor.pos() );
+    turns.remove( actor );
+    actors.destroy( actor );
+}
+
+ItemList::iterator place_item( MapItem&& item )
+{
+    items.emplace_back( std::move(item) );
+    ItemList::iterator it = --std::end( items );
+
+    ItemList::iterator& top = itemGrid.get( it->pos );
+    it->below = top;
+    top = it;
+    mark_dirty( it->pos );
+    stateHash += hash_item( *it );
+
+    return it;
+}
+
+void remove_item( ItemList::iterator item )
+{
+    ItemList::iterator* link = &itemGrid.get( item->pos );
+    while( *link != item )
+        link = &(*link)->below;
+    *link = item->below;
+
+    mark_dirty( item->pos );
+    stateHash -= hash_item( *item );
+    items.erase( item );
+}
+
+void expire( Actor actor )
+{
+    // Move weapon to inventory; drop inventory.
+    if( actor.wielding() ) actor.unwield();
+    while( actor.inventory().size() ) drop( actor, 0 );
+
+    if( actor == player ) player = NOBODY;
+
+    // Create a corpse based on the dead actor's race.
+    const ThingData& race = races[ actor.race() ];
+    MapItem corpse( Item(CORPSE_ID), actor.pos() );
+    corpse.race = actor.race();
+    corpse.stats = race.stats;
+    corpse.name = std::string(race.name) + " corpse";
+    place_item( std::move(corpse) );
+
+    remove_actor( actor );
+}
+
+bool walkable( const Vec& pos )
+{
+    return pos.x() > 0 and pos.y() > 0 
+       and pos.x() < grid.width and pos.y() < grid.height 
+       and grid.get( pos ).walkable();
+}
+
+int clamp( int x, int min, int max )
+{
+    if( x < min )      x = min;
+    else if( x > max ) x = max;
+    return x;
+}
+
+template< class C/*ontainer*/ >
+auto random_select( C&& c ) -> decltype( c[0] )
+{ return c[ random(0, c.size()-1) ]; }
+
+void ask_name()
+{
+    // A little intro screen. Just asks for the player's name.
+    while( true )
+    {
+        TCODConsole::root->setAlignment( TCOD_CENTER );
+        TCODConsole::root->print( 40, 5, "Welcome to this WIP roguelike. " );
+        TCODConsole::root->print( 40, 10, "You may notice sone hitches," );
+
+        TCODConsole::root->setAlignment( TCOD_LEFT );
+        TCODConsole::root->print( 30, 20, "Please enter in your name: " );
+        TCODConsole::root->print( 30, 23, playerName.c_str() );
+
+        TCODConsole::root->flush();
+        TCODConsole::root->clear();
+
+        TCOD_key_t key;
+        do key = TCODConsole::waitForKeypress( false );
+        while( not key.pressed );
+
+        if( key.vk == TCODK_ENTER ) {
+            // Don't leave without a name, 
+            // but don't add the newline char to playerName either.
+            if( playerName.size() > 0 ) 
+                break;
+            else {
+                TCODConsole::root->print ( 
+                    30, 25, "Your name must be at least one character long." 
+                );
+                continue;
+            }
+        }
+
+        if( key.c )
+            playerName.push_back( key.c );
+    }
+}
+
+std::vector< Vec > read_mapgen( Grid<Tile>& g )
+{
+    // This runs on the dungeon's thread, so it mustn't die() on failure:
+    // without spawn points, enter_level() will, on the game's.
+    FILE* mapgen = popen( "./mapgen/c++/mapgen -n 5 -X 16", "r" );
+    if( not mapgen ) {
+        perror( "mapgen" );
+        return std::vector< Vec >();
+    }
+
+    // Read the map in, line by line.
+    for( unsigned int y=0; y < g.height; y++ ) {
+        char line[500];
+        
+        // Fails on the first line if mapgen didn't run.
+        if( not fgets(line, sizeof line, mapgen) or line[0] != '#' ) {
+            fprintf( stderr, "mapgen: Too few rows. Expected %zu, got %u.\n", 
+                     g.height, y );
+            pclose( mapgen );
+            return std::vector< Vec >();
+        }
+        if( strlen(line) < g.width or line[g.width-1] != '#' ) {
+            fprintf( stderr, "mapgen: Wrong number of columns. "
+                     "Expected %zu, got (N\\A).\n", g.width );
+            pclose( mapgen );
+            return std::vector< Vec >();
+        }
+
+        std::copy_n( line, g.width, g.row_begin(y) );
+    }
+
+    // Read spawn points.
+    std::vector< Vec > spawns;
+    char spawnpt[50];
+    while( fgets(spawnpt, sizeof spawnpt, mapgen) ) {
+        unsigned int x, y;
+        if( sscanf(spawnpt, "X %u %u", &x, &y) == 2 )
+            spawns.push_back( Vec(x, y) );
+    }
+
+    pclose( mapgen );
+    return spawns;
+}
+
+void enter_level( Level&& level )
+{
+    ALLOC_SCOPE( LEVEL );
+
+    // Everyone but the player stays behind.
+    for( size_t i = actors.size(); i--; )
+        if( actors[i] != player )
+            remove_actor( actors[i] );
+
+    items.clear();
+
+    grid = std::move( level.grid );
+    grid.reset_flags( N_TILE_FLAGS );
+    if( not on_map(level.entrance) )
+        die( "No spawn point!\n" );
+
+    // Size everything kept per tile to the new map.
+    itemGrid.reset( grid.width, grid.height, std::end(items) );
+    actorGrid.reset( grid.width, grid.height, NOBODY );
+    fov.reset( grid.width, grid.height );
+    dirty.reset( grid.width, grid.height, false );
+
+    // Start the hash over from the new map; everyone gets added back in.
+    stateHash = zobrist::hash_grid( grid );
+    std::fill( actorHash.begin(), actorHash.end(), 0 );
+
+    // Newcomers shouldn't get to catch up on all the turns they missed.
+    int now = 0;
+    if( player == NOBODY ) {
+        player = actors.create();
+        player.name() = playerName;
+        player.race() = HUMAN_ID;
+        player.set_base( races[HUMAN_ID].stats );
+        player.hp() = player.stats()[HP];
+        turns.insert( player, player.nextMove() );
+    } else {
+        now = player.nextMove();
+    }
+
+    player.pos() = level.entrance;
+    place_actor( player );
+    rehash_actor( player );
+
+    for( const Spawn& s : level.monsters ) {
+        // Two actors can't share a spawn point.
+        if( actor_at(s.pos) != NOBODY )
+            continue;
+
+        Actor actor = actors.create();
+        actor.pos() = s.pos;
+        actor.race() = s.id;
+        actor.name() = std::string("the ") + races[actor.race()].name;
+
+        actor.pickup( Item(s.weapon) );
+        actor.wield( 0 );
+
+        actor.set_base( races[actor.race()].stats );
+        actor.hp() = actor.stats()[HP];
+        actor.nextMove() = now;
+
+        place_actor( actor );
+        turns.insert( actor, actor.nextMove() );
+        rehash_actor( actor );
+    }
+
+    for( const Spawn& s : level.items )
+        place_item( MapItem(Item(s.id), s.pos) );
+
+    redraw_all();
+    playerDistance.reset( grid.width, grid.height );
+    update_map( player.pos() );
+}
+
+void update_map( const Vec& pos )
+{
+    TRACE_SCOPE( "update_map" );
+    ALLOC_SCOPE( MAP );
+
+    {
+        perf::Timer t( perf::FOV );
+        compute_fov( grid, pos, FOV_RADIUS, fov );
+    }
+    {
+        perf::Timer t( perf::DISTANCE );
+        playerDistance.move_root( grid, pos );
+    }
+
+    update_visibility();
+}
+
+void update_visibility()
+{
+    BitPlane& visible = grid.flags( VISIBLE );
+
+    // Redraw what came into or went out of view.
+    visible ^= fov;
+    visible.for_each_set( []( size_t x, size_t y ) { mark_dirty( Vec(x,y) ); } );
+
+    visible.assign( fov );
+    grid.flags( SEEN ) |= fov;
+}
+
+/*
+ * Who or what a message is about, by what it is rather than by handle, so
+ * that it can still be named after it's gone: a NounKind and a ThingId,
+ * packed into one Event argument.
+ */
+enum NounKind { NOUN_PLAYER, NOUN_MONSTER, NOUN_ITEM, NOUN_CORPSE };
+
+uint32_t noun( NounKind k, ThingId id ) { return uint32_t(k) << 16 | id; }
+
+uint32_t noun( Actor actor )
+{
+    return actor == player ? noun( NOUN_PLAYER, 0 ) 
+                           : noun( NOUN_MONSTER, actor.race() );
+}
+
+uint32_t noun( const Item& item )
+{
+    return item.id == CORPSE_ID ? noun( NOUN_CORPSE, item.race )
+                                : noun( NOUN_ITEM, item.id );
+}
+
+/* Write n's name to out, as snprintf does. Matches Actor::name(). */
+int name( uint32_t n, char* out, size_t size )
+{
+    ThingId id = n & 0xffff;
+    switch( n >> 16 ) {
+      case NOUN_PLAYER:  return snprintf( out, size, "%s", playerName.c_str() );
+      case NOUN_MONSTER: return snprintf( out, size, "the %s", races[id].name );
+      case NOUN_CORPSE:  return snprintf( out, size, "%s corpse", races[id].name );
+      default:           return snprintf( out, size, "%s", catalogue[id].name );
+    }
+}
+
+/* args: the dropper, the item, and whether to call the dropper "You". */
+int format_drop( const msg::Event& e, char* out, size_t size )
+{
+    char who[ msg::TEXT_LEN ], what[ msg::TEXT_LEN ];
+    if( e.args[2] )
+        strcpy( who, "You" );
+    else
+        name( e.args[0], who, sizeof who );
+    name( e.args[1], what, sizeof what );
+
+    return snprintf( out, size, "%s dropped the %s", who, what );
+}
+
+const char* const ATTACK_VERBS[] = { 
+    "missed", "dodged", "hit", "critically hit", "killed" 
+};
+
+// Marks, in an attack's result, a critical hit, even if it killed.
+const uint32_t CRITICAL_HIT = 0x100;
+
+/* args: the result, the aggressor, the victim and the weapon. */
+int format_attack( const msg::Event& e, char* out, size_t size )
+{
+    char aggressor[ msg::TEXT_LEN ], victim[ msg::TEXT_LEN ], 
+         weapon[ msg::TEXT_LEN ];
+    name( e.args[1], aggressor, sizeof aggressor );
+    name( e.args[2], victim, sizeof victim );
+    name( e.args[3], weapon, sizeof weapon );
+
+    uint32_t result = e.args[0] & ~CRITICAL_HIT;
+    if( result == DODGED )
+        return snprintf( out, size, "%s dodged %s's %s.", 
+                         victim, aggressor, weapon );
+
+    // "attacker's wpn (hit/missed) who(./!)"
+    return snprintf( out, size, "%s's %s %s %s%c", 
+                     aggressor, weapon, ATTACK_VERBS[result], victim,
+                     e.args[0] & CRITICAL_HIT ? '!' : '.' );
+}
+
+bool drop( Actor actor, unsigned int ii )
+{
+    Actor::Inventory& inv = actor.inventory();
+    if( actor.in_inventory(ii) ) 
+    {
+        const auto item = std::begin(inv) + ii;
+
+        if( fov.get(actor.pos().x(), actor.pos().y()) ) {
+            // A dying player drops things in the third person.
+            bool you = actor == player and actor.hp() > 0;
+            msg::normal( {format_drop, {noun(actor), noun(*item), you}} );
+        }
+        
+        place_item( MapItem(std::move(*item), actor.pos()) );
+        actor.drop( ii );
+
+        return true;
+    } 
+    else if( actor == player ) 
+    {
+        msg::normal( "You don't have that!" );
+    }
+
+    return false;
+}
+
+void _look_loop( Actor player )
+{
+    ALLOC_SCOPE( UI );
+
+    Vec lpos = player.pos(); // Look position.
+    while( true )
+    {
+        const Tile& t = grid.get( lpos );
+        bool seen    = grid.flag( SEEN, lpos );
+        bool visible = grid.flag( VISIBLE, lpos );
+
+        // Highlight the path from the cursor to the player.
+        // Iterate only once if the player hasn't discovered this tile.
+        Vec pos = lpos; 
+        do highlight( pos );
+        while( seen and playerDistance.descend(pos) );
+
+        // The path may not reach the player.
+        highlight( player.pos() );
+
+        // Tell the player what they're looking at; longer text is cut short.
+        char info[ INFO_LEN + 1 ];
+
+        Actor actor;
+        ItemList::iterator item;
+        if( not seen )
+            snprintf( info, sizeof info, "(undiscovered)" );
+        else if( visible and (actor=actor_at(lpos)) == player )
+            snprintf( info, sizeof info, "It's you!" );
+        else if( visible and actor != NOBODY )
+            snprintf( info, sizeof info, "You see a %s.", 
+                      actor.name().c_str() );
+        else if( (item=item_at(lpos)) != std::end(items) )
+            snprintf( info, sizeof info, "You see a %s.", item->name.c_str() );
+        else
+            snprintf( info, sizeof info, "%s", t.type().description );
+        int len = strlen( info );
+
+        infobox.clear();
+        infobox.setDefaultForeground( TCODColor::green );
+        infobox.print( 0, 0, "%s", info );
+
+        overlay_blit (
+            &infobox, len, 1,
+            // Draw centered on the x-axis
+            clamp( lpos.x()-len/2, 1, grid.width-len ), 
+            // and just above or below on the y-axis.
+            lpos.y() + (lpos.y() > 3 ? -2 : +2),
+            1, 0.5f
+        );
+
+        render();
+
+        switch( next_pressed_key() ) {
+          // Cardinal directions.
+          case 'h': case '4': case TCODK_LEFT:  lpos.x() -= 1; break;
+          case 'l': case '6': case TCODK_RIGHT: lpos.x() += 1; break;
+          case 'k': case '8': case TCODK_UP:    lpos.y() -= 1; break;
+          case 'j': case '2': case TCODK_DOWN:  lpos.y() += 1; break;
+
+          // Diagonals.
+          case 'y': case '7': lpos += Vec(-1,-1); break;
+          case 'u': case '9': lpos += Vec(+1,-1); break;
+          case 'b': case '1': lpos += Vec(-1,+1); break;
+          case 'n': case '3': lpos += Vec(+1,+1); break;
+
+          // Render one last time to unset the highlight path 
+          // and erase the infobox.
+          default: render(); return;
+        }
+    }
+}
+
+/* 
+ * Render the inventory; wait for key press.
+ * Returns an inventory index, assuming the player hit a key corresponding to a
+ * held item.
+ */
+int _render_inventory( Actor player )
+{
+    ALLOC_SCOPE( UI );
+
+    if( not player.inventory().size() )
+        msg::normal( "You don't have anything." );
+
+    // Whatever was printed last time is still there.
+    invcons.setDefaultBackground( TCODColor::black );
+    invcons.clear();
+
+    // Number of lines before inventory proper. 
+    unsigned int heading = 0;
+
+    if( player.wielding() )
+    {
+        heading = 1;
+
+        invcons.setDefaultForeground( TCODColor::green );
+        invcons.print( 0, heading++, "A - (%c)%s -- wielded.",
+                       player.weapon().symbol, player.weapon().name.c_str() );
+    }
+
+    unsigned int y = 0;
+    invcons.setDefaultForeground( TCODColor::white );
+    for( const Item& i : player.inventory() ) 
+        invcons.print( 0, heading + y++, 
+                       "%c - (%c)%s", iitoc(y), i.symbol, i.name.c_str() );
+
+    invcons.setDefaultForeground( TCODColor::red );
+    invcons.print( 0, heading + y, "Press any key." );
+
+    // Centered, as if it were as tall as the inventory plus three lines.
+    int height = player.inventory().size() + 3;
+    overlay_blit (
+        &invcons, invcons.getWidth(), heading + y,
+        grid.width  / 2 - invcons.getWidth() / 2, 
+        grid.height / 2 - height / 2
+    );
+
+    // Show the inventory (printed to overlay).
+    render();
+    // Wait for the player to finish reading.
+    int k = next_pressed_key();
+    // Erase the inventory.
+    render();
+
+    return ctoii( k );
+}
+
+Action move_player( Actor player )
+{
+    Vec pos( 0, 0 );
+    switch( next_pressed_key() ) {
+      case 'q': return Action::QUIT;
+
+      // Cardinal directions.
+      case 'h': case '4': case TCODK_LEFT:  pos.x() -= 1; break;
+      case 'l': case '6': case TCODK_RIGHT: pos.x() += 1; break;
+      case 'k': case '8': case TCODK_UP:    pos.y() -= 1; break;
+      case 'j': case '2': case TCODK_DOWN:  pos.y() += 1; break;
+
+      // Diagonals.
+      case 'y': case '7': pos = Vec(-1,-1); break;
+      case 'u': case '9': pos = Vec(+1,-1); break;
+      case 'b': case '1': pos = Vec(-1,+1); break;
+      case 'n': case '3': pos = Vec(+1,+1); break;
+
+      case '.': case '5': return Action::WAIT;
+
+      case 'L': _look_loop( player ); 
+                return move_player(player);
+
+      case 'i':  _render_inventory( player ); 
+                 return move_player(player);
+
+      case 'P': perf::toggle();
+                render();
+                return move_player(player);
+
+      case 'g': return Action::PICKUP;
+
+      case 'd': // Drop
+        {
+            msg::special( "Pick an item." );
+            // _render_inventory will display this message and return an
+            // inventory index.
+            int ii = _render_inventory( player );
+
+            if( ii < player.inventory().size() and ii >= 0 ) {
+                return Action( Action::DROP, ii );
+            } else {
+                msg::normal( "You don't have that!", ii );
+                render();
+                return move_player( player );
+            }
+        }
+
+      case 'e': // Equip
+        {
+            msg::special( "Equip what? (Type '.' (period) for nothing.)" );
+            unsigned int ii = _render_inventory( player );
+            if( player.in_inventory(ii) ) 
+            {
+                player.wield( ii );
+                msg::special( "Eqipped %s.", player.weapon().name.c_str() );
+                render();
+            } 
+            else if( ii == ctoii('.') )
+            {
+                if( not player.unwield() )
+                    msg::special( "You weren't wielding anything." );
+            }
+
+            return move_player( player );
+        }
+
+      case '>': return Action::DESCEND;
+
+      case 'E': // Eat
+        {
+            msg::special( "Eat what?" );
+            unsigned int ii = _render_inventory( player );
+            if( player.in_inventory(ii) )
+                return Action( Action::EAT, ii );
+
+            msg::normal( "You don't have that." );
+        }
+
+
+      default: ;
+    }
+
+    if( pos.x() or pos.y() )
+        return Action( Action::MOVE, pos + player.pos() );
+
+    // The player has not yet moved (or we would have returned already).
+    return move_player( player );
+}
+
+Action move_bot( Actor bot )
+{
+    if( item_at(bot.pos()) != std::end(items) )
+        return Action::PICKUP;
+
+    if( grid.get(bot.pos()).kind() == TILE_STAIRS_DOWN )
+        return Action::DESCEND;
+
+    for( const Vec& d : DIRS )
+        if( actor_at(bot.pos() + d) != NOBODY )
+            return Action( Action::MOVE, bot.pos() + d );
+
+    // Keep heading the same way until something's in the way.
+    static Vec heading( 0, 0 );
+    if( (heading.x() or heading.y()) and walkable(bot.pos() + heading) 
+        and not rng( AI ).one_in(10) )
+        return Action( Action::MOVE, bot.pos() + heading );
+
+    Vec options[8];
+    int n = 0;
+    for( const Vec& d : DIRS )
+        if( walkable(bot.pos() + d) )
+            options[n++] = d;
+
+    if( not n )
+        return Action::WAIT;
+
+    heading = options[ rng( AI ).below(n) ];
+    return Action( Action::MOVE, bot.pos() + heading );
+}
+
+Action move_monst( Actor monst )
+{
+    TRACE_SCOPE( "move_monst" );
+    ALLOC_SCOPE( AI );
+    perf::Timer t( perf::AI );
+
+    const Vec& pos = monst.pos();
+
+    if( not fov.get(pos.x(), pos.y()) )
+        return Action( Action::WAIT );
+
+    // Walk downhill. On ties, prefer the step that looks most direct.
+    Vec best = pos;
+    int bestDist = playerDistance.get( pos );
+    int bestLine = 0;
+
+    if( bestDist < 0 )
+        return Action( Action::WAIT ); // Too far to find the way.
+
+    for( const Vec& d : DIRS ) {
+        Vec next = pos + d;
+        if( not walkable(next) )
+            continue;
+
+        // Don't walk into other monsters; walking into the player attacks.
+        Actor other = actor_at( next );
+        if( other != NOBODY and other != player )
+            continue;
+
+        int dist = playerDistance.get( next );
+        if( dist < 0 )
+            continue; // Unreachable.
+
+        int line = magnitude_sqr( player.pos() - next );
+        if( dist < bestDist or (dist == bestDist and best != pos 
+                                and line < bestLine) ) {
+            best = next;
+            bestDist = dist;
+            bestLine = line;
+        }
+    }
+
+    if( best == pos )
+        return Action( Action::WAIT );
+    return Action( Action::MOVE, best );
+}
+
+bool attack( Actor aggressor, Actor victim )
+{
+    TRACE_SCOPE( "attack" );
+    ALLOC_SCOPE( COMBAT );
+
+    Blow blow = roll_attack( aggressor.stats(), victim.stats(), rng(COMBAT) );
+    AttackResult verb = land( blow, victim.hp() );
+    bool criticalHit = blow.result == CRITICAL;
+
+    // Only fights the player can see make it to the screen.
+    bool seen = aggressor == player or victim == player
+             or fov.get( aggressor.pos().x(), aggressor.pos().y() )
+             or fov.get( victim.pos().x(), victim.pos().y() );
+
+    msg::combat( {format_attack, 
+                  {verb | (criticalHit ? CRITICAL_HIT : 0), noun(aggressor),
+                   noun(victim), noun(aggressor.weapon())}}, seen );
+
+    return verb == KILLED;
+}
+
+void init_palette()
+{
+    typedef TCODColor C;
+
+    for( int k=0; k < N_TILE_KINDS; k++ ) {
+        TileLook remembered = { C::white, C::black };
+        TileLook visible    = { C::white, C::black };
+
+        if( k == TILE_WALL ) {
+            visible    = { C::darkAzure, C::darkGrey };
+            remembered = { C::darkestAzure, C::black };
+        } else if( tileTypes[k].walkable ) {
+            visible    = { C::darkestHan, C::grey };
+            remembered = { C::lightBlue, C::darkestGrey };
+        }
+
+        // Highlighting brightens; more so what can't be seen.
+        palette[k][ LOOK_REMEMBERED ] = remembered;
+        palette[k][ LOOK_VISIBLE ]    = visible;
+        palette[k][ LOOK_LIT_REMEMBERED ] = 
+            { remembered.fg * 3.f, remembered.bg * 3.f };
+        palette[k][ LOOK_LIT_VISIBLE ] = 
+            { visible.fg * 1.5f, visible.bg * 1.5f };
+    }
+}
+
+/* Draw the cell at (x,y) of the map, and whatever is on it, to screen. */
+void draw_cell( int x, int y )
+{
+    /*
+     * Draw any tile, except those the player hasn't discovered.
+     * color them according to whether or not:
+     *  they can be seen now (visible),
+     *  have been discovered (seen),
+     *  is highlighted (highlight).
+     */
+    const Tile& t = grid.get( x, y );
+    bool visible = grid.flag( VISIBLE, x, y );
+    bool lit     = grid.flag( HIGHLIGHT, x, y );
+
+    typedef TCODColor C;
+
+    // Not in view, nor discovered.
+    if( not grid.flag(SEEN, x, y) ) { 
+        screen->putCharEx( x, y, ' ', C::white, C::black );
+
+        // Player may be looking at this tile. 
+        if( lit ) {
+            // Print the cursor.
+            overlay.setChar( x, y, 'X' );
+            overlay.setCharForeground( x, y, C::black );
+            overlay.setCharBackground( x, y, C::grey );
+            mark_overlay( Room(x, x, y, y) );
+        }
+
+        return;
+    }
+
+    int c = t.c;
+    const TileLook& look = palette[ t.kind() ][ visible + 2*lit ];
+    C fg = look.fg;
+    C bg = look.bg;
+
+    // Draw it again, unlit, next time.
+    if( lit )
+        mark_dirty( Vec(x,y) );
+
+    // Only what's on visible tiles gets drawn.
+    if( visible ) {
+        Vec pos( x, y );
+        Actor actor = actorGrid.get( pos );
+        ItemList::iterator item = itemGrid.get( pos );
+
+        if( actor != NOBODY ) {
+            const ThingData& race = races[ actor.race() ];
+            c  = race.symbol;
+            fg = race.color;
+        } else if( item != std::end(items) ) {
+            const ThingData& thing = catalogue[ item->id ];
+            c  = thing.symbol;
+            fg = thing.color;
+        }
+    }
+
+    screen->putCharEx( x, y, c, fg, bg );
+}
+
+/*
+ * Draw the performance panel in the top right corner: the mean over the
+ * last perf::N_FRAMES frames of the work done per frame and in each phase,
+ * the longest frame, and the game thread's allocations per frame.
+ */
+void _render_perf()
+{
+    size_t n = perf::n_frames();
+    if( not n )
+        return;
+
+    uint64_t work = 0, longest = 0;
+    uint64_t phase[ perf::N_PHASES ] = { };
+    unsigned long allocs = 0, bytes = 0;
+    for( size_t i=0; i < n; i++ ) {
+        const perf::Frame& f = perf::frame( i );
+        work += f.work();
+        allocs += f.allocs;
+        bytes  += f.bytes;
+        longest = std::max( longest, f.work() );
+        for( int p=0; p < perf::N_PHASES; p++ )
+            phase[p] += f.phase[p];
+    }
+
+    const double MS = 1e6; // ns per ms.
+
+    perfPanel.setDefaultBackground( TCODColor::darkestGrey );
+    perfPanel.setDefaultForeground( TCODColor::white );
+    perfPanel.clear();
+
+    int y = 0;
+    perfPanel.print( 0, y++, "frame %6.2fms max %6.2f", 
+                     work / MS / n, longest / MS );
+    // Input isn't work; it's left out of frame above and of the panel.
+    for( int p=0; p < perf::INPUT; p++ )
+        perfPanel.print( 0, y++, "%-8s %6.2fms", 
+                         perf::PHASE_NAMES[p], phase[p] / MS / n );
+
+    const perf::Frame& last = perf::frame( 0 );
+    perfPanel.print( 0, y++, "actors %u items %u", last.actors, last.items );
+    perfPanel.print( 0, y++, "allocs %.1f %.0fB", 
+                     double(allocs) / n, double(bytes) / n );
+
+    overlay_blit( &perfPanel, PERF_WIDTH, y, grid.width - PERF_WIDTH, 0 );
+}
+
+void render()
+{
+    TRACE_SCOPE( "render" );
+    ALLOC_SCOPE( RENDER );
+
+    if( not rendering )
+        return;
+
+    // A frame runs from one render to the next, this one included.
+    perf::end_frame( actors.size(), items.size() );
+    perf::Timer t( perf::RENDER );
+
+    // Uncover what the overlay hid last frame.
+    for( const Room& r : overlayShown )
+        mark_dirty( r );
+    overlayShown.clear();
+
+    // Draw the changed parts of the map onto screen. Cells marked while
+    // drawing go in the next frame's queue.
+    static std::vector< Vec > drawing;
+    drawing.swap( dirtyCells );
+    for( const Vec& pos : drawing ) {
+        dirty.get( pos ) = false;
+        draw_cell( pos.x(), pos.y() );
+    }
+    drawing.clear();
+
+    // Highlights last one frame; every lit cell has been drawn.
+    grid.flags( HIGHLIGHT ).clear();
+
+    // Print messages.
+    const int SIZE = grid.width / 2; // Max size of message.
+    msgbox.setBackgroundFlag( TCOD_BKGND_SET );
+
+    int y = 0;
+    int x = player != NOBODY and player.pos().x() > SIZE ?  
+        1 : SIZE;
+    msg::for_each (
+        [&]( const msg::Message& m )
+        {
+            msgbox.setDefaultForeground( m.fg );
+            msgbox.setDefaultBackground( m.bg );
+            msgbox.print( 0, 0, "%s", m.text );
+
+            float alpha = float(m.duration) / msg::DURATION;
+            overlay_blit( &msgbox, m.len, 1, x, y++, alpha, alpha );
+        }
+    );
+
+    // Print a health bar.
+    if( player != NOBODY ) {
+        int y = grid.height - 1; // y-position of health bar.
+
+        overlay.setDefaultBackground( TCODColor::red );
+        overlay.setDefaultForeground( TCODColor::white );
+        unsigned int width = 
+            (float(player.hp())/player.stats()[HP]) * (grid.width/2);
+        overlay.hline( 0, y, width, TCOD_BKGND_SET );
+        mark_overlay( Room(0, grid.width-1, y, y) );
+
+        const char* healthFmt = width > sizeof "xx / xx" ? 
+            "%d / %d" : "%d/%d";
+        char healthInfo[ sizeof "-2147483648 / -2147483648" ];
+        snprintf( healthInfo, sizeof healthInfo, healthFmt, 
+                  player.hp(), player.stats()[HP] );
+
+        TCOD_alignment_t allignment = strlen(healthInfo) < width ?
+            TCOD_CENTER : TCOD_LEFT;
+        overlay.setAlignment( allignment );
+        overlay.print( width/2, y, "%s", healthInfo );
+    }
+
+    if( perf::shown )
+        _render_perf();
+
+    // The overlay needs a blit-transparent key color, which cannot be black as
+    // that may be used. Any uncommon color will do.
+    const TCODColor KEY_COLOR(0.01f,0.01f,0.01f);
+    overlay.setKeyColor( KEY_COLOR );
+
+    // Only blit what was drawn on; then erase it from overlay.
+    for( const Room& r : overlayRegions )
+        TCODConsole::blit (
+            &overlay, r.left, r.up, r.right-r.left+1, r.down-r.up+1,
+            screen, r.left, r.up,
+            1, 1
+        );
+
+    overlay.setDefaultForeground( TCODColor::white );
+    overlay.setDefaultBackground( KEY_COLOR );
+    for( const Room& r : overlayRegions )
+        overlay.rect( r.left, r.up, r.right-r.left+1, r.down-r.up+1, 
+                      true, TCOD_BKGND_SET );
+
+    overlayShown.swap( overlayRegions );
+
+    if( window )
+        TCODConsole::flush();
+}
+
+void mark_dirty( const Vec& pos )
+{
+    bool& d = dirty.get( pos );
+    if( not d ) {
+        d = true;
+        dirtyCells.push_back( pos );
+    }
+}
+
+void mark_dirty( const Room& r )
+{
+    for( unsigned int y=r.up; y <= r.down; y++ )
+        for( unsigned int x=r.left; x <= r.right; x++ )
+            mark_dirty( Vec(x,y) );
+}
+
+void redraw_all()
+{
+    std::fill_n( dirty.tiles, dirty.area(), false );
+    dirtyCells.clear();
+    mark_dirty( Room(0, grid.width-1, 0, grid.height-1) );
+
+    overlay.setDefaultBackground( TCODColor(0.01f,0.01f,0.01f) );
+    overlay.clear();
+    overlayRegions.clear();
+    overlayShown.clear();
+}
+
+void mark_overlay( const Room& r )
+{
+    overlayRegions.push_back( r );
+}
+
+void overlay_blit( const TCODConsole* src, int w, int h, int x, int y,
+                   float fgAlpha, float bgAlpha )
+{
+    // Keep the region on the map.
+    if( x < 0 ) x = 0;
+    if( y < 0 ) y = 0;
+    w = std::min( w, int(grid.width)  - x );
+    h = std::min( h, int(grid.height) - y );
+    if( w <= 0 or h <= 0 )
+        return;
+
+    TCODConsole::blit( src, 0, 0, w, h, &overlay, x, y, fgAlpha, bgAlpha );
+    mark_overlay( Room(x, x+w-1, y, y+h-1) );
+}
+
+void highlight( const Vec& pos )
+{
+    if( not on_map(pos) )
+        return;
+    grid.set_flag( HIGHLIGHT, pos );
+    mark_dirty( pos );
+}
+
+Vec keep_inside( const TCODConsole& cons, Vec v )
+{
+    v.x( clamp(v.x(), 1, cons.getWidth()-1) );
+    v.y( clamp(v.y(), 1, cons.getWidth()-1) );
+    return v;
+}
+
+int next_pressed_key()
+{
+    perf::Timer t( perf::INPUT );
+
+    if( replaying ) {
+        // Out of keys: quit, from whatever menu the player is in.
+        int k;
+        if( not record::next_key(k) )
+            return 'q';
+
+        if( watchDelay > 0 )
+            std::this_thread::sleep_for( std::chrono::milliseconds(watchDelay) );
+        return k;
+    }
+
+    TCOD_key_t key;
+        
+    do key = TCODConsole::waitForKeypress(false);
+    while( not key.pressed );
+
+    int k = key.vk == TCODK_CHAR ? key.c : (int)key.vk;
+
+    if( k >= TCODK_0 and k <= TCODK_9 )
+        k = '0' + (k - TCODK_0);
+    if( k >= TCODK_KP0 and k <= TCODK_KP9 )
+        k = '0' + (k - TCODK_KP0);
+
+    record::key( k );
+    return k;
+}
+
+bool on_map( const Vec& pos )
+{
+    return pos.x() >= 0 and pos.y() >= 0 
+       and pos.x() < int(grid.width) and pos.y() < int(grid.height);
+}
+
+bool blocked( const Vec& pos )
+{
+    if( grid.get(pos).kind() == TILE_WALL )
+        return true;
+    return actor_at(pos) != NOBODY;
+}
+
+/*
+ * Stop the other threads before exit() destroys what they use: the sink
+ * formats events from playerName, races and catalogue.
+ */
+void _stop_threads()
+{
+    msg::stop_sink();
+    dungeon.stop();
+}
+
+#include <cstdarg>
+void die( const char* fmt, ... )
+{
+    va_list vl;
+    va_start( vl, fmt );
+    vfprintf( stderr, fmt, vl );
+    va_end( vl );
+    _stop_threads();
+    exit( 1 );
+}
+
+void die_perror( const char* msg )
+{
+    perror( msg );
+    _stop_threads();
+    exit( 1 );
+}
@@ -0,0 +1,253 @@
+
+#pragma once
+
+#include "Vector.h"
+#include "Grid.h"
+#include "Scheduler.h"
+#include "Actor.h"
+#include "BitPlane.h"
+#include "DistanceMap.h"
+#include "Dungeon.h"
+
+#include "Rogue.h"
+
+#include "libtcod.hpp"
+
+#include <cstdio>
+#include <cstdint>
+#include <list>
+#include <string>
+#include <vector>
+
+/*
+ * The game: its state, and the actions on it that main() drives turn by
+ * turn. Declared here so that bench can set up a level and time them too.
+ */
+
+extern Vec mapDims;
+
+extern Grid<Tile> grid;
+
+/* Levels yet to be visited; the first is made when the game starts. */
+extern Dungeon dungeon;
+
+/*
+ * The hash of the game state: the map, items and actors. The map's part is
+ * computed once per level; items and actors are kept up to date as they
+ * change, and each actor's share is kept in actorHash so it can be replaced.
+ */
+extern uint64_t stateHash;
+extern std::vector< uint64_t > actorHash; // By handle.
+
+/* Where to write stateHash every turn, if anywhere. */
+extern FILE* hashLog;
+
+struct MapItem;
+typedef std::list<MapItem> ItemList;
+
+struct MapItem : Item
+{
+    Vec pos;
+
+    // The next item down in the stack on this tile, or std::end(items).
+    ItemList::iterator below;
+
+    MapItem() {}
+    MapItem( const Item& item, const Vec& pos )
+        : Item( item ), pos( pos ) { }
+    MapItem( Item&& item, const Vec& pos )
+        : Item( std::move(item) ), pos( pos ) { }
+};
+
+extern ActorStore actors;
+extern ItemList   items;
+
+/*
+ * What's on each tile: the actor standing there and the top of the item
+ * stack, or NOBODY/std::end(items). Kept in sync by place_actor,
+ * move_actor, remove_actor, place_item and remove_item.
+ */
+extern Grid< Actor > actorGrid;
+extern Grid< ItemList::iterator > itemGrid;
+
+extern Actor player;
+extern std::string playerName;
+
+struct TurnSlot
+{
+    size_t& operator()( Actor a ) { return actors.turnSlot[a.id]; }
+};
+
+/* Every living actor, ordered by nextMove. */
+extern Scheduler< Actor, TurnSlot > turns;
+
+/* Player's Field of Vision: the tiles the player can see. */
+extern BitPlane fov;
+/*
+ * How far out from the player to keep distances, in tiles. Monsters only
+ * move when in view, so this need only cover paths to the edge of the view
+ * that wind around a bit.
+ */
+const int PATH_RADIUS = 20;
+/* Distances from player. */
+extern DistanceMap playerDistance;
+
+/*
+ * Where render() draws: TCODConsole::root normally, or an offscreen console
+ * when running without a window.
+ */
+extern TCODConsole* screen;
+
+/* Run without a window; the player is driven by move_bot(). */
+extern bool headless;
+
+/*
+ * Play the keys from a recorded game instead of the keyboard. Unless
+ * watching it, there's no window, nothing is rendered and it runs as fast as
+ * it can.
+ */
+extern bool replaying;
+extern int watchDelay; // Milliseconds between replayed keys; -1 to not watch.
+
+/* Whether there's a window, and whether render() does anything. */
+extern bool window;
+extern bool rendering;
+
+/* Read levels from ./mapgen/c++/mapgen instead of generate_bsp(). */
+extern bool externalMapgen;
+
+/*
+ * Graphical overlay to draw UI.
+ * Painted over TCODConsole::root in render() offering no transparency.
+ */
+extern TCODConsole overlay;
+
+/* Radius of the player's field of vision. */
+const int FOV_RADIUS = 10;
+
+struct Action
+{
+    enum Type {
+        MOVE,
+        WAIT,
+        ATTACK,
+        PICKUP,
+        DROP,
+        EAT,
+        DESCEND,
+        QUIT
+    } type;
+
+    // If type=MOVE/ATTACK, holds the destination.
+    Vec pos;
+
+    unsigned int inventoryIndex;
+
+    Action() : type(WAIT) {}
+
+    Action( Type type, Vec pos=Vec(0,0) )
+        : type( type ), pos( pos )
+    {
+    }
+
+    Action( Type type, unsigned int ii )
+        : type( type ), inventoryIndex( ii )
+    {
+    }
+};
+
+/* The actor at pos, or NOBODY; off the map too. */
+Actor actor_at( const Vec& pos );
+
+/* The item on top of the stack at pos. */
+ItemList::iterator item_at( const Vec& pos );
+
+/* Put a new actor in the occupancy index. */
+void place_actor( Actor actor );
+void move_actor( Actor actor, const Vec& pos );
+
+/* Bring actor's share of stateHash up to date, after it changed. */
+void rehash_actor( Actor actor );
+
+/* Take actor off the map, out of the scheduler, and erase it. */
+void remove_actor( Actor actor );
+
+/* Add item to items, on top of whatever stack is at item.pos. */
+ItemList::iterator place_item( MapItem&& item );
+
+/* Unlink item from its stack and erase it. */
+void remove_item( ItemList::iterator item );
+
+/* Expire: Drop all items. Remove from actors list. Become a corpse. */
+void expire( Actor actor );
+
+/* True if pos is on the map, inside its border, and can be walked on. */
+bool walkable( const Vec& pos );
+
+int clamp( int x, int min, int max );
+
+/*
+ * Make level the current one: take its map, clear out everything but the
+ * player and populate it. The player arrives at the level's entrance, and is
+ * created there on the first level.
+ */
+void enter_level( Level&& level );
+
+/*
+ * Run the external mapgen (with -m) and read its map into g.
+ * Returns the spawn points it printed, or none if it failed, after saying
+ * why on stderr. Safe to call from the dungeon's thread.
+ */
+std::vector< Vec > read_mapgen( Grid<Tile>& g );
+
+/* Update fov and playerDistance. */
+void update_map( const Vec& pos );
+
+/* Exit gracefully. */
+void die( const char* fmt, ... );
+void die_perror( const char* msg );
+
+/*
+ * Do all rendering.
+ * Calculate FOV based on player's position, draw all discovered tiles,
+ * colorize, and print to libtcod's root.
+ */
+void render();
+
+/* Queue the whole map and clear the overlay; for a new level. */
+void redraw_all();
+
+/* Fill the table of tile colors render() draws with. */
+void init_palette();
+
+/* Handle keyboard input on player's turn. */
+Action move_player( Actor );
+
+/*
+ * Play for the player when running headless.
+ * Pick up anything underfoot, take any stairs down, attack anything adjacent,
+ * otherwise wander.
+ */
+Action move_bot( Actor );
+
+/* Show the intro screen and read the player's name into playerName. */
+void ask_name();
+
+/*
+ * Move monster.
+ * If visible by player, move towards and attack player.
+ * Otherwise, sit tight.
+ *
+ * Monsters share playerDistance as a flow field: each steps to the free
+ * neighbour closest to the player, in O(1).
+ */
+Action move_monst( Actor );
+
+/* Simulate attack and print a message. Return true on kill. */
+bool attack( Actor aggressor, Actor victim );
+
+/* Drop actor.inventory()[i], if exists. Returns true on success. */
+bool drop( Actor actor, unsigned int ii );
+
+/* True if pos lies on the map. */
+bool on_map( const Vec& pos );
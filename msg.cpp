@@ -1,32 +1,244 @@
 
 #include "msg.h"
-#include "Rogue.h" // For grid.width in Message::width.
-#include <list>
+#include "SpscQueue.h"
+#include "alloc.h"
+
 #include <cstdarg>
+#include <algorithm>
+#include <cstring>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
 
 namespace msg
 {
 
 const int DURATION = 4;
 
-struct Message
+namespace detail
+{
+Message ring[ CAPACITY ];
+size_t newest = 0, count = 0;
+}
+
+namespace
+{
+
+// A message on its way to the sink: text, or an event to format there.
+struct Line
 {
-    std::string msg;
-    TCODColor fg, bg;
-    int duration; // How many times this message should be printed.
+    char text[ TEXT_LEN ];
+    size_t len;
+    Event event;
+    bool isEvent;
 };
 
-::std::list< Message > messageList;
+// How much of n, as returned by snprintf into TEXT_LEN chars, got written.
+size_t _written( int n )
+{
+    return n <= 0 ? 0 : std::min( size_t(n), TEXT_LEN - 1 );
+}
+
+/*
+ * The sink thread drains lines from the queue and writes them with one
+ * fwrite per batch. When the queue is full, the game waits for it: messages
+ * are never dropped.
+ *
+ * Either side sleeps on wake when it can't go on: the writer when the queue
+ * is empty, the game when it's full. Each says so in its asleep flag first,
+ * so the other only takes the lock to wake it when it may be asleep.
+ */
+struct Sink
+{
+    FILE* out;
+    SpscQueue< Line, 1024 > lines;
+    std::thread writer;
+    std::atomic< bool > quit;
+
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::atomic< bool > writerAsleep, gameAsleep;
+
+    Sink() : out( 0 ), quit( false ), writerAsleep( false ), gameAsleep( false )
+    {}
+    ~Sink() { stop(); }
+
+    void start( FILE* f )
+    {
+        stop();
+        out = f;
+        quit = false;
+        writer = std::thread( &Sink::work, this );
+    }
+
+    void stop()
+    {
+        if( not writer.joinable() )
+            return;
+        quit = true;
+        {
+            std::lock_guard< std::mutex > lock( mutex );
+            wake.notify_all();
+        }
+        writer.join();
+        out = 0;
+    }
+
+    bool running() const { return out; }
+
+    void push( const char* text, size_t len )
+    {
+        Line l;
+        memcpy( l.text, text, len );
+        l.len = len;
+        l.isEvent = false;
+        push( l );
+    }
+
+    void push( const Event& e )
+    {
+        Line l;
+        l.event = e;
+        l.isEvent = true;
+        push( l );
+    }
+
+    void push( Line& l )
+    {
+        while( not lines.push(std::move(l)) )
+            sleep( gameAsleep, [&]{ return lines.size() < lines.capacity(); } );
+        wake_up( writerAsleep );
+    }
+
+    /* Sleep until woken, unless ready() already; callers check again. */
+    template< typename F >
+    void sleep( std::atomic< bool >& asleep, F ready )
+    {
+        std::unique_lock< std::mutex > lock( mutex );
+        asleep = true;
+        // Pairs with wake_up()'s fence: either it sees asleep, or we see
+        // what it did before calling it.
+        std::atomic_thread_fence( std::memory_order_seq_cst );
+        if( not ready() )
+            wake.wait( lock );
+        asleep = false;
+    }
+
+    void wake_up( std::atomic< bool >& asleep )
+    {
+        std::atomic_thread_fence( std::memory_order_seq_cst );
+        if( asleep ) {
+            std::lock_guard< std::mutex > lock( mutex );
+            wake.notify_all();
+        }
+    }
+
+    void work()
+    {
+        static char batch[ 64 * 1024 ];
+
+        while( true ) {
+            // Read quit first, so nothing pushed before it was set is missed.
+            bool last = quit;
+
+            size_t n = 0;
+            Line l;
+            while( n + TEXT_LEN <= sizeof batch and lines.pop(l) ) {
+                if( l.isEvent ) {
+                    n += _written( l.event.format(l.event, batch + n, TEXT_LEN) );
+                } else {
+                    memcpy( batch + n, l.text, l.len );
+                    n += l.len;
+                }
+                batch[ n++ ] = '\n';
+            }
+
+            if( n ) {
+                wake_up( gameAsleep ); // There's room now.
+                fwrite( batch, 1, n, out );
+                fflush( out );
+            } else if( last ) {
+                break;
+            } else {
+                sleep( writerAsleep, 
+                       [&]{ return lines.size() > 0 or quit; } );
+            }
+        }
+    }
+};
+
+Sink sink;
+
+// Take the slot after the newest message, overwriting the oldest if full.
+Message& _next_message( const TCODColor& fg, const TCODColor& bg )
+{
+    using namespace detail;
+
+    newest = (newest + 1) % CAPACITY;
+    if( count < CAPACITY )
+        count++;
+
+    Message& m = ring[ newest ];
+    m.fg = fg;
+    m.bg = bg;
+    m.duration = DURATION;
+    return m;
+}
 
 void _push_msg( const char* fmt, va_list vl, 
                 const TCODColor& fg, const TCODColor& bg )
 {
-    char* msg;
-    if( vasprintf(&msg,fmt,vl) > 0 ) {
-        messageList.push_front ( {msg, fg, bg, DURATION} );
-        printf( "%s\n", msg );
-        free( msg );
+    ALLOC_SCOPE( MSG );
+
+    char text[ TEXT_LEN ];
+    size_t len = _written( vsnprintf(text, TEXT_LEN, fmt, vl) );
+    if( not len )
+        return;
+
+    Message& m = _next_message( fg, bg );
+    memcpy( m.text, text, len + 1 );
+    m.len = len;
+    m.formatted = true;
+
+    if( sink.running() )
+        sink.push( m.text, m.len );
+}
+
+void _push_event( const Event& e, bool onScreen,
+                  const TCODColor& fg, const TCODColor& bg )
+{
+    ALLOC_SCOPE( MSG );
+
+    if( onScreen ) {
+        Message& m = _next_message( fg, bg );
+        m.event = e;
+        m.formatted = false;
     }
+
+    if( sink.running() )
+        sink.push( e );
+}
+
+} // namespace
+
+void Message::format()
+{
+    if( formatted )
+        return;
+    len = _written( event.format(event, text, TEXT_LEN) );
+    text[ len ] = '\0';
+    formatted = true;
+}
+
+void start_sink( FILE* out )
+{
+    sink.start( out );
+}
+
+void stop_sink()
+{
+    sink.stop();
 }
 
 void combat( const char* fmt, ... )
@@ -60,19 +272,15 @@ void normal( const char* fmt, ... )
     va_end( vl );
 }
 
-void for_each( const Fn& f )
+void combat( const Event& e, bool onScreen )
 {
-    typedef std::list<Message>::iterator I;
-    for( I it = std::begin(messageList); it != std::end(messageList); it++ )
-    {
-        if( it->duration <= 0 ) {
-            messageList.erase( it, std::end(messageList) );
-            break;
-        }
+    _push_event( e, onScreen,
+                 TCODColor::lightestFlame, TCODColor::desaturatedYellow );
+}
 
-        f( it->msg, it->fg, it->bg, it->duration );
-        it->duration--;
-    }
+void normal( const Event& e, bool onScreen )
+{
+    _push_event( e, onScreen, TCODColor::white, TCODColor::black );
 }
 
 } // namespace msg
@@ -1,6 +1,9 @@
 
-#include <string>
-#include <functional>
+#pragma once
+
+#include <cstddef>
+#include <cstdio>
+#include <cstdint>
 
 #include "libtcod.hpp"
 
@@ -9,20 +12,95 @@ namespace msg
 
 extern const int DURATION; // How long a message will last.
 
+const size_t TEXT_LEN = 80; // Longer messages are cut short.
+const size_t CAPACITY = 32; // How many messages are kept for the screen.
+
+/*
+ * A message not yet put into words: what happened, as a few numbers whose
+ * meaning is up to format. It is only formatted if it's shown or written,
+ * and then possibly on another thread, so format must only read what
+ * doesn't change during the game.
+ */
+struct Event
+{
+    // Write at most n chars, counting the '\0', to out, as snprintf does.
+    typedef int (*Format)( const Event&, char* out, size_t n );
+
+    Format format;
+    uint32_t args[ 4 ];
+};
+
+struct Message
+{
+    char text[ TEXT_LEN ];
+    size_t len;
+    TCODColor fg, bg;
+    int duration; // How many times this message should be printed.
+
+    Event event;
+    bool formatted; // text is up to date with event.
+
+    /* Put event into words, if not done yet. */
+    void format();
+};
+
 /* 
  * Message printing functions.
  * Each function will result in a message of a different color.
+ * Only one thread, the game's, may print messages.
  */
 void combat(  const char* fmt, ... ) __attribute__((format (printf, 1, 2)));
 void special( const char* fmt, ... ) __attribute__((format (printf, 1, 2)));
 void normal(  const char* fmt, ... ) __attribute__((format (printf, 1, 2)));
 
+/*
+ * Print an event, formatting it only when it's shown or written. Unless
+ * onScreen, it only goes to the sink; without one, it costs nothing.
+ */
+void combat( const Event& e, bool onScreen=true );
+void normal( const Event& e, bool onScreen=true );
+
+/*
+ * Write every message from now on to out, one per line. A thread of its own
+ * does the writing, in batches, so printing a message only waits on I/O
+ * when more than a queue's worth of lines are waiting to be written. The
+ * thread sleeps while there's nothing to write.
+ * stop_sink() writes out whatever is left. Call it before exiting: the
+ * events still queued are formatted from the game's globals, which static
+ * destruction may already have taken.
+ * Without a sink, messages only go to the screen.
+ */
+void start_sink( FILE* out );
+void stop_sink();
+
+// The newest messages, newest at ring[newest]; the rest follow backwards.
+namespace detail
+{
+extern Message ring[ CAPACITY ];
+extern size_t newest, count;
+}
+
 /* 
- * For each message, do f and decrement the duration.
- * Used to print each message to the screen.
+ * For each message, newest first, do f(const Message&) and decrement the
+ * duration. Used to print each message to the screen.
  */
-typedef std::function< void(const std::string&,
-                            const TCODColor&,const TCODColor&, int) > Fn; 
-void for_each( const Fn& f );
+template< typename F >
+void for_each( F f )
+{
+    using namespace detail;
+    for( size_t i=0; i < count; i++ ) {
+        Message& m = ring[ (newest + CAPACITY - i) % CAPACITY ];
+
+        // This one has expired, and so have all older.
+        if( m.duration <= 0 ) {
+            count = i;
+            break;
+        }
+
+        m.format();
+        f( (const Message&)m );
+        m.duration--;
+    }
+}
 
 }
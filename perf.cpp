@@ -0,0 +1,76 @@
+#include "perf.h"
+
+namespace perf
+{
+
+const char* const PHASE_NAMES[ N_PHASES ] = {
+    "fov", "dijkstra", "ai", "render", "input"
+};
+
+bool shown = false;
+
+namespace
+{
+
+Frame frames[ N_FRAMES ];
+size_t last  = 0; // Where the last closed frame is.
+size_t count = 0; // How many frames have been closed, up to N_FRAMES.
+
+Frame current;
+uint64_t currentStart = 0; // Zero when no frame is open.
+alloc::Count startAllocs;
+
+} // namespace
+
+void toggle()
+{
+    shown = not shown;
+    count = 0;
+    currentStart = 0;
+}
+
+void add( Phase p, uint64_t ns )
+{
+    if( shown )
+        current.phase[p] += ns;
+}
+
+void end_frame( unsigned int actors, unsigned int items )
+{
+    if( not shown )
+        return;
+
+    uint64_t now = trace::now();
+    alloc::Count allocated = alloc::total();
+
+    // Frames only count from a start we saw; the first just opens one.
+    if( currentStart ) {
+        current.ns = now - currentStart;
+        current.actors = actors;
+        current.items = items;
+        alloc::Count since = allocated - startAllocs;
+        current.allocs = since.allocs;
+        current.bytes  = since.bytes;
+
+        last = (last + 1) % N_FRAMES;
+        frames[last] = current;
+        if( count < N_FRAMES )
+            count++;
+    }
+
+    current = Frame();
+    currentStart = now;
+    startAllocs = allocated;
+}
+
+const Frame& frame( size_t i )
+{
+    return frames[ (last + N_FRAMES - i) % N_FRAMES ];
+}
+
+size_t n_frames()
+{
+    return count;
+}
+
+} // namespace perf
@@ -0,0 +1,74 @@
+
+#pragma once
+
+#include "trace.h" // For trace::now().
+#include "alloc.h"
+
+#include <cstddef>
+#include <cstdint>
+
+/*
+ * Frame and turn timings for the in-game performance panel.
+ *
+ * A frame is everything the game does from one render() to the next: the
+ * monsters' turns, the player's, and the render itself. Each is kept as a
+ * Frame in a fixed ring, so the panel can show a rolling average without
+ * allocating. Nothing is timed while the panel is hidden.
+ */
+
+namespace perf
+{
+
+enum Phase {
+    FOV,      // compute_fov().
+    DISTANCE, // playerDistance, the Dijkstra map.
+    AI,       // move_monst().
+    RENDER,
+    INPUT,    // Waiting for a key; not work, so not part of Frame::work().
+    N_PHASES
+};
+
+extern const char* const PHASE_NAMES[ N_PHASES ];
+
+struct Frame
+{
+    uint64_t ns;                  // From the last frame's start to this one's.
+    uint64_t phase[ N_PHASES ];   // Time in each phase, in ns.
+    unsigned int actors, items;   // How many there were when it ended.
+    unsigned long allocs, bytes;  // Allocated by the game thread.
+
+    uint64_t work() const { return ns - phase[INPUT]; }
+};
+
+const size_t N_FRAMES = 64;
+
+/* Whether the panel is shown, and so whether anything is timed. */
+extern bool shown;
+
+/* Show or hide the panel. The first frame after showing it starts fresh. */
+void toggle();
+
+/* Add ns to the current frame's phase. */
+void add( Phase p, uint64_t ns );
+
+/*
+ * Close the current frame, as of now, and start the next. Only call it from
+ * the game thread: allocations are counted by thread.
+ */
+void end_frame( unsigned int actors, unsigned int items );
+
+/* The i'th frame back, 0 being the last one closed, and how many there are. */
+const Frame& frame( size_t i );
+size_t n_frames();
+
+/* Time the enclosing scope as phase p; only while the panel is shown. */
+struct Timer
+{
+    Phase phase;
+    uint64_t start;
+
+    Timer( Phase p ) : phase( p ), start( shown ? trace::now() : 0 ) {}
+    ~Timer() { if( start ) add( phase, trace::now() - start ); }
+};
+
+} // namespace perf
@@ -1,10 +1,90 @@
 
 #include "random.h"
 
-#include <ctime> // To seed random number.
-#include <cstdlib>
+#include <utility>
 
-int seed = 0;
+namespace
+{
+    // Constant-initialized, so reaching them costs no check for a first use.
+    // Until reseed(), every thread starts from the same fixed seed.
+    thread_local Rng streams[ N_STREAMS ] = { 
+        Rng( 1 ), Rng( 2 ), Rng( 3 ), Rng( 4 ) 
+    };
+
+    static_assert( N_STREAMS == 4, "Give every stream an initial seed." );
+}
+
+void Rng::seed( uint64_t seed )
+{
+    for( int i=0; i < 4; i++ )
+        s[i] = rng_detail::splitmix( seed, i+1 );
+}
+
+void Rng::fill( uint64_t* out, size_t n )
+{
+    for( size_t i=0; i < n; i++ )
+        out[i] = next();
+}
+
+void Rng::fill( int* out, size_t n, int min, int max )
+{
+    if( min > max )
+        std::swap( min, max );
+
+    uint32_t span = uint32_t(max) - uint32_t(min) + 1;
+    if( not span ) {
+        for( size_t i=0; i < n; i++ )
+            out[i] = int( next() >> 32 );
+        return;
+    }
+
+    // As below(), but with the threshold worked out once, and two numbers
+    // taken from each word.
+    const uint32_t threshold = -span % span;
+    size_t i = 0;
+    while( i < n ) {
+        uint64_t w = next();
+        for( uint32_t x : { uint32_t(w >> 32), uint32_t(w) } ) {
+            uint64_t m = uint64_t(x) * span;
+            if( uint32_t(m) >= threshold and i < n )
+                out[i++] = int( uint32_t(min) + uint32_t(m >> 32) );
+        }
+    }
+}
+
+void Rng::jump()
+{
+    static const uint64_t JUMP[] = { 
+        0x180ec6d33cfd0abaULL, 0xd5a61266f0c9392cULL, 
+        0xa9582618e03fc9aaULL, 0x39abdc4529b1661cULL 
+    };
+
+    uint64_t t[4] = { 0, 0, 0, 0 };
+    for( uint64_t j : JUMP )
+        for( int b=0; b < 64; b++ ) {
+            if( j & (uint64_t(1) << b) )
+                for( int i=0; i < 4; i++ )
+                    t[i] ^= s[i];
+            next();
+        }
+
+    for( int i=0; i < 4; i++ )
+        s[i] = t[i];
+}
+
+Rng& rng( Stream s )
+{
+    return streams[ s ];
+}
+
+void reseed( uint64_t seed )
+{
+    for( int i=0; i < N_STREAMS; i++ ) {
+        streams[i].seed( seed );
+        for( int j=0; j < i; j++ )
+            streams[i].jump();
+    }
+}
 
 int random( int max )
 {
@@ -13,12 +93,5 @@ int random( int max )
 
 int random( int min, int max )
 {
-    if( not seed ) {
-        seed = std::time(0);
-        srand( seed );
-    }
-
-    if( min > max )
-        return random( max, min );
-    return rand() % (max-min+1) + min;
+    return streams[ GENERAL ].range( min, max );
 }
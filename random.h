@@ -1,5 +1,119 @@
-
 #pragma once
 
+#include <cstdint>
+#include <cstddef>
+
+namespace rng_detail
+{
+    // SplitMix64, for turning one seed into many well-mixed words.
+    const uint64_t GOLDEN = 0x9e3779b97f4a7c15ULL;
+
+    constexpr uint64_t mix1( uint64_t z )
+    { return (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL; }
+    constexpr uint64_t mix2( uint64_t z )
+    { return (z ^ (z >> 27)) * 0x94d049bb133111ebULL; }
+    constexpr uint64_t mix3( uint64_t z ) { return z ^ (z >> 31); }
+
+    /* The nth output of SplitMix64 seeded with seed. */
+    constexpr uint64_t splitmix( uint64_t seed, uint64_t n )
+    { return mix3( mix2( mix1(seed + n*GOLDEN) ) ); }
+}
+
+/*
+ * A xoshiro256** generator: 256 bits of state, a period of 2^256 - 1 and a
+ * few cycles per number. Seeding is explicit; two generators with the same
+ * seed give the same numbers on any thread.
+ */
+struct Rng
+{
+    uint64_t s[4];
+
+    constexpr Rng( uint64_t seed = 0 )
+        : s{ rng_detail::splitmix( seed, 1 ), rng_detail::splitmix( seed, 2 ),
+             rng_detail::splitmix( seed, 3 ), rng_detail::splitmix( seed, 4 ) }
+    {
+    }
+
+    void seed( uint64_t seed );
+
+    uint64_t next()
+    {
+        const uint64_t result = rotl( s[1] * 5, 7 ) * 9;
+        const uint64_t t = s[1] << 17;
+
+        s[2] ^= s[0];
+        s[3] ^= s[1];
+        s[1] ^= s[2];
+        s[0] ^= s[3];
+
+        s[2] ^= t;
+        s[3] = rotl( s[3], 45 );
+
+        return result;
+    }
+
+    /* Uniform in [0, n), without the bias of next() % n. n > 0. */
+    uint32_t below( uint32_t n )
+    {
+        // Lemire's multiply-shift; reject the few values that would wrap
+        // unevenly onto the low results.
+        uint64_t m = uint64_t(uint32_t(next() >> 32)) * n;
+        if( uint32_t(m) < n ) {
+            const uint32_t threshold = -n % n;
+            while( uint32_t(m) < threshold )
+                m = uint64_t(uint32_t(next() >> 32)) * n;
+        }
+        return m >> 32;
+    }
+
+    /* Uniform in [min, max], inclusive. Swaps them if min > max. */
+    int range( int min, int max )
+    {
+        if( min > max )
+            return range( max, min );
+
+        uint32_t span = uint32_t(max) - uint32_t(min) + 1;
+        if( not span ) // [INT_MIN, INT_MAX]
+            return int( next() >> 32 );
+        return int( uint32_t(min) + below(span) );
+    }
+
+    /* True one time in n. */
+    bool one_in( uint32_t n ) { return below( n ) == 0; }
+
+    /* Fill out with n raw words, or with n numbers in [min, max]. */
+    void fill( uint64_t* out, size_t n );
+    void fill( int* out, size_t n, int min, int max );
+
+    /* 
+     * Skip ahead 2^128 numbers. Jumping copies of one generator a different
+     * number of times gives streams that will never overlap.
+     */
+    void jump();
+
+  private:
+    static uint64_t rotl( uint64_t x, int k ) { return (x << k) | (x >> (64 - k)); }
+};
+
+/*
+ * Each subsystem draws from its own stream, so that, say, an extra combat
+ * roll doesn't change the next map. Every thread has its own set.
+ */
+enum Stream
+{
+    GENERAL, // What random() uses.
+    MAPGEN,
+    COMBAT,
+    AI,
+    N_STREAMS
+};
+
+/* This thread's generator for stream s. */
+Rng& rng( Stream s );
+
+/* Seed all of this thread's streams from one seed, as non-overlapping jumps. */
+void reseed( uint64_t seed );
+
+/* Uniform in [0, max] and [min, max], from the GENERAL stream. */
 int random( int max );
 int random( int min, int max);
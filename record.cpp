@@ -0,0 +1,134 @@
+
+#include "record.h"
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+namespace record
+{
+
+const char MAGIC[4] = { 'R', 'G', 'L', 'G' };
+const unsigned char VERSION = 1;
+
+// Keys at least this big take the long form.
+const unsigned char LONG_KEY = 0xff;
+
+FILE* out = 0;
+
+// A loaded log, and how far into it replay is.
+std::vector< unsigned char > log;
+size_t pos = 0;
+
+void put_uint( unsigned char* buf, uint64_t x, int bytes )
+{
+    for( int i=0; i < bytes; i++ )
+        buf[i] = x >> (8*i);
+}
+
+uint64_t get_uint( const unsigned char* buf, int bytes )
+{
+    uint64_t x = 0;
+    for( int i=0; i < bytes; i++ )
+        x |= uint64_t(buf[i]) << (8*i);
+    return x;
+}
+
+bool start( const char* path, const Header& h )
+{
+    stop();
+    out = fopen( path, "wb" );
+    if( not out )
+        return false;
+
+    size_t nameLen = h.name.size() < 0xff ? h.name.size() : 0xff;
+
+    unsigned char head[ sizeof MAGIC + 1 + 8 + 1 + 1 ];
+    memcpy( head, MAGIC, sizeof MAGIC );
+    head[4] = VERSION;
+    put_uint( head + 5, h.seed, 8 );
+    head[13] = h.externalMapgen;
+    head[14] = nameLen;
+
+    fwrite( head, sizeof head, 1, out );
+    fwrite( h.name.data(), nameLen, 1, out );
+    fflush( out );
+    return true;
+}
+
+void key( int k )
+{
+    if( not out )
+        return;
+
+    unsigned char buf[5];
+    size_t n = 1;
+    if( k >= 0 and k < LONG_KEY ) {
+        buf[0] = k;
+    } else {
+        buf[0] = LONG_KEY;
+        put_uint( buf + 1, uint32_t(k), 4 );
+        n = 5;
+    }
+
+    // Keys come at the speed of a hand on a keyboard; one write each is
+    // nothing next to the wait for the next.
+    fwrite( buf, n, 1, out );
+    fflush( out );
+}
+
+void stop()
+{
+    if( out )
+        fclose( out );
+    out = 0;
+}
+
+bool load( const char* path, Header& h )
+{
+    FILE* in = fopen( path, "rb" );
+    if( not in )
+        return false;
+
+    log.clear();
+    unsigned char buf[4096];
+    size_t n;
+    while( (n = fread(buf, 1, sizeof buf, in)) > 0 )
+        log.insert( log.end(), buf, buf + n );
+    fclose( in );
+
+    const size_t HEAD = sizeof MAGIC + 1 + 8 + 1 + 1;
+    if( log.size() < HEAD or memcmp(log.data(), MAGIC, sizeof MAGIC) 
+        or log[4] != VERSION )
+        return false;
+
+    h.seed = get_uint( log.data() + 5, 8 );
+    h.externalMapgen = log[13];
+
+    size_t nameLen = log[14];
+    if( log.size() < HEAD + nameLen )
+        return false;
+    h.name.assign( (const char*)log.data() + HEAD, nameLen );
+
+    pos = HEAD + nameLen;
+    return true;
+}
+
+bool next_key( int& k )
+{
+    if( pos >= log.size() )
+        return false;
+
+    if( log[pos] != LONG_KEY ) {
+        k = log[ pos++ ];
+        return true;
+    }
+
+    if( pos + 5 > log.size() )
+        return false;
+    k = int32_t( get_uint(log.data() + pos + 1, 4) );
+    pos += 5;
+    return true;
+}
+
+} // namespace record
@@ -0,0 +1,43 @@
+
+#pragma once
+
+#include <string>
+#include <cstdint>
+
+/*
+ * Recorded games: the seed, the player's name and every key pressed, which
+ * is all it takes to play a game over again exactly.
+ *
+ * A log is "RGLG", a version byte, the seed (eight bytes, little-endian), a
+ * byte that is 1 if levels came from the external mapgen, the name's length
+ * (one byte) and the name, then the keys. A key below 0xff takes one byte;
+ * any other is 0xff followed by four.
+ */
+namespace record
+{
+
+struct Header
+{
+    uint64_t seed;
+    bool externalMapgen; // Replays of these won't get the same levels.
+    std::string name;
+};
+
+/* Start recording to path. False if it can't be written. */
+bool start( const char* path, const Header& h );
+
+/* 
+ * Append a key. It reaches the file before it is acted on, so a log is
+ * complete even if the game then crashes.
+ */
+void key( int k );
+
+void stop();
+
+/* Load the log at path for replay. False if unreadable or not a log. */
+bool load( const char* path, Header& h );
+
+/* The next recorded key. False when there are none left. */
+bool next_key( int& k );
+
+} // namespace record
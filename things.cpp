@@ -0,0 +1,46 @@
+
+#include "Actor.h"
+
+/*
+ * The stats, and everything else, of every race and item. Kept apart from the
+ * game so that tools like duel can use them too.
+ */
+
+namespace stats
+{
+    // The base stats added to every race.
+    Stats base = {{ 10, 10, 10, 10, 10, 10 }};
+
+    // Racial stats.
+    Stats human  = Stats{{ 10,  5,  5,  0,  5,  -5 }} + base;
+    Stats kobold = Stats{{  0, -3, 10,  8,  5, -10 }} + base;
+    Stats bear   = Stats{{ 30, 10, -5, -5,  0,   1 }} + base;
+    
+    // Item stats.
+    Stats nothing = Stats{{ 0, 0,  0, 0, 0, 0 }};
+    Stats stick   = Stats{{ 0, 5,  0, 0, 3, 0 }};
+
+    // Gives extra health, but slows its wielder.
+    Stats pillow  = Stats{{ 5, 1, -3, 0, 0, 2 }};
+                          
+    // A special item that makes one super-quick and accurate.
+    Stats thumbTack = Stats{{ 2, 0, 10, 10, -30 }};
+}
+
+std::vector< ThingData > catalogue = {
+    { "fist",    ' ', TCODColor::black,        stats::nothing,   -1, -1 },
+    { "stick",   '/', TCODColor(200,150, 100), stats::stick,      0, 10 },
+    { "pillow",  '-', TCODColor::white,        stats::pillow,     0, 10 },
+    { "thumb tack", '-', TCODColor::green,     stats::thumbTack, -1, -1 },
+
+    // Takes its name and stats from the race that died.
+    { "corpse",  '%', TCODColor(170, 60, 60),  stats::nothing,   -1, -1 }
+};
+
+std::vector< ThingData > races = {
+    { "human",  '@', TCODColor(200,150, 50), stats::human,  0, 10 },
+    { "kobold", 'K', TCODColor(100,200,100), stats::kobold, 0, 10 },
+    { "bear",   'B', TCODColor(250,250,100), stats::bear,   0, 10 }
+};
+
+const Item Actor::FIST = Item( FIST_ID );
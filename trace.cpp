@@ -0,0 +1,143 @@
+
+#include "trace.h"
+
+#include <cstdio>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <vector>
+
+namespace trace
+{
+
+uint64_t now()
+{
+    return std::chrono::duration_cast< std::chrono::nanoseconds >(
+        std::chrono::steady_clock::now().time_since_epoch() ).count();
+}
+
+#ifdef TRACE
+
+namespace
+{
+
+struct Event
+{
+    const char* name;
+    uint64_t start, end;
+};
+
+/*
+ * One thread's events. Only its thread writes to it; write() reads it from
+ * another. Events go in fixed-size chunks that never move, and are
+ * published by bumping count, so the reader only ever sees whole events.
+ */
+struct Buffer
+{
+    static const size_t CHUNK = 1 << 14;
+    static const size_t MAX_CHUNKS = 1 << 10;
+
+    std::atomic< Event* > chunks[ MAX_CHUNKS ];
+    std::atomic< size_t > count;
+    const char* threadName;
+    unsigned int tid;
+
+    Buffer( unsigned int tid ) : count( 0 ), threadName( 0 ), tid( tid )
+    {
+        for( auto& c : chunks )
+            c = 0;
+    }
+
+    void push( const Event& e )
+    {
+        size_t n = count.load( std::memory_order_relaxed );
+        size_t c = n / CHUNK;
+        if( c >= MAX_CHUNKS )
+            return; // Full; drop the rest.
+
+        Event* chunk = chunks[c].load( std::memory_order_relaxed );
+        if( not chunk ) {
+            chunk = new Event[ CHUNK ];
+            chunks[c].store( chunk, std::memory_order_release );
+        }
+
+        chunk[ n % CHUNK ] = e;
+        count.store( n + 1, std::memory_order_release );
+    }
+};
+
+// Times are written relative to this, in microseconds.
+const uint64_t origin = now();
+
+// Every thread's buffer. Buffers outlive their threads, so that their
+// events can still be written; the lock is only taken once per thread.
+std::mutex buffersLock;
+std::vector< Buffer* > buffers;
+
+Buffer& this_thread_buffer()
+{
+    static thread_local Buffer* buffer = 0;
+    if( not buffer ) {
+        std::lock_guard< std::mutex > lock( buffersLock );
+        buffer = new Buffer( buffers.size() + 1 );
+        buffers.push_back( buffer );
+    }
+    return *buffer;
+}
+
+} // namespace
+
+void record( const char* name, uint64_t start, uint64_t end )
+{
+    this_thread_buffer().push( Event{ name, start, end } );
+}
+
+void name_thread( const char* name )
+{
+    this_thread_buffer().threadName = name;
+}
+
+void write( const char* path )
+{
+    FILE* out = fopen( path, "w" );
+    if( not out ) {
+        perror( path );
+        return;
+    }
+
+    std::lock_guard< std::mutex > lock( buffersLock );
+
+    fprintf( out, "{\"traceEvents\":[\n" );
+    const char* sep = "";
+    for( Buffer* b : buffers ) {
+        if( b->threadName ) {
+            fprintf( out, "%s{\"name\":\"thread_name\",\"ph\":\"M\","
+                     "\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"%s\"}}",
+                     sep, b->tid, b->threadName );
+            sep = ",\n";
+        }
+
+        size_t n = b->count.load( std::memory_order_acquire );
+        for( size_t i=0; i < n; i++ ) {
+            const Event& e = b->chunks[ i / Buffer::CHUNK ].load(
+                std::memory_order_acquire )[ i % Buffer::CHUNK ];
+            fprintf( out, "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,"
+                     "\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+                     sep, e.name, b->tid, (e.start - origin) / 1000.0,
+                     (e.end - e.start) / 1000.0 );
+            sep = ",\n";
+        }
+    }
+    fprintf( out, "\n]}\n" );
+    fclose( out );
+}
+
+#else
+
+void record( const char*, uint64_t, uint64_t ) {}
+void name_thread( const char* ) {}
+void write( const char* ) {}
+
+#endif
+
+} // namespace trace
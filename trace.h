@@ -0,0 +1,61 @@
+
+#pragma once
+
+#include <cstdint>
+
+/*
+ * Scoped timers for the game's hot paths, written out as a Chrome trace
+ * (load it in chrome://tracing or ui.perfetto.dev).
+ *
+ * Tracing is compiled in with -DTRACE (make TRACE=1); without it, the
+ * macros below are empty and cost nothing. Each thread records into buffers
+ * of its own, so recording takes no lock and shares no cache lines.
+ */
+
+#ifdef TRACE
+
+#define TRACE_CAT2( a, b ) a##b
+#define TRACE_CAT( a, b ) TRACE_CAT2( a, b )
+
+/* Time from here to the end of the enclosing scope, as name. */
+#define TRACE_SCOPE( name ) \
+    trace::Scope TRACE_CAT( _traceScope, __LINE__ )( name )
+
+/* Show the calling thread as name in the trace. */
+#define TRACE_THREAD( name ) trace::name_thread( name )
+
+#else
+
+#define TRACE_SCOPE( name )
+#define TRACE_THREAD( name )
+
+#endif
+
+namespace trace
+{
+
+/* Nanoseconds on a steady clock. */
+uint64_t now();
+
+/* Record a span of time on the calling thread. name must outlive the trace. */
+void record( const char* name, uint64_t start, uint64_t end );
+
+void name_thread( const char* name );
+
+/*
+ * Write what every thread has recorded so far to path, as trace JSON.
+ * Threads may keep recording meanwhile; what they add is left out. Does
+ * nothing when tracing is compiled out.
+ */
+void write( const char* path );
+
+struct Scope
+{
+    const char* name;
+    uint64_t start;
+
+    Scope( const char* name ) : name( name ), start( now() ) {}
+    ~Scope() { record( name, start, now() ); }
+};
+
+} // namespace trace
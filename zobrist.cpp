@@ -0,0 +1,15 @@
+
+#include "zobrist.h"
+
+namespace zobrist
+{
+
+uint64_t hash_grid( const Grid<Tile>& g )
+{
+    uint64_t h = 0;
+    for( size_t i=0; i < g.area(); i++ )
+        h += key( TILE, (unsigned char)g.tiles[i].c, i );
+    return h;
+}
+
+} // namespace zobrist
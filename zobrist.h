@@ -0,0 +1,47 @@
+
+#pragma once
+
+#include "Rogue.h"
+#include "random.h" // For rng_detail::splitmix.
+
+#include <cstdint>
+
+/*
+ * Zobrist-style hashing of the game state.
+ *
+ * Every feature of the state (a tile's glyph, an item on a tile, an actor's
+ * position, hp or next move) has a pseudo-random 64-bit key, and the state's
+ * hash is the sum of the keys of its features. Adding, removing or changing
+ * one feature updates the hash in O(1). Keys are computed from the feature,
+ * rather than looked up in tables, since hp and times are unbounded. Sums,
+ * rather than XOR, keep two identical items on a tile from cancelling out.
+ */
+namespace zobrist
+{
+
+enum Kind
+{
+    TILE,
+    ITEM,
+    ACTOR_POS,
+    ACTOR_HP,
+    ACTOR_NEXT,
+    ACTOR_RACE
+};
+
+/* The key of feature kind with value b, of thing a. a < 2^24. */
+inline uint64_t key( Kind k, uint32_t a, uint32_t b )
+{
+    return rng_detail::splitmix( (uint64_t(k) << 56) ^ (uint64_t(a) << 32) ^ b, 
+                                 1 );
+}
+
+inline uint32_t pack( const Vec& p )
+{
+    return uint32_t(p.x()) | (uint32_t(p.y()) << 16);
+}
+
+/* The sum of the keys of every tile: O(area), for a new map. */
+uint64_t hash_grid( const Grid<Tile>& g );
+
+} // namespace zobrist